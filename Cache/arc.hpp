@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <span>
+
+#include "batch.hpp"
+#include "slab.hpp"
+
+namespace caches {
+    // Adaptive Replacement Cache (Megiddo & Modha, FAST'03). T1 holds keys seen
+    // once recently, T2 keys seen at least twice; B1 and B2 remember keys
+    // evicted from them. A hit in B1 means T1 was too small and grows the
+    // target size p of T1, a hit in B2 shrinks it, so the recency/frequency
+    // split follows the workload instead of being fixed at 50/50.
+    template<typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class arc_cache {
+    public:
+        using size_type = size_t;
+        using hash_type = typename slab_list<KeyT, Hash>::hash_type;
+    public:
+        arc_cache(size_type capacity) : cap{capacity}, t1{capacity}, t2{capacity}, b1{capacity}, b2{capacity} {}
+
+        bool full() const { return t1.size() + t2.size() == cap; }
+
+        bool lookup_update(KeyT key) { return lookup_update(key, hash(key)); }
+        bool lookup_update(KeyT key, hash_type h);
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return t1.hash(key); }
+        // ghost lists are only probed on a miss, prefetching them as well costs more than it saves
+        void prefetch(hash_type h) const {
+            t1.prefetch(h);
+            t2.prefetch(h);
+        }
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            t1.prefetch_entry(key, h);
+            t2.prefetch_entry(key, h);
+        }
+
+        bool isPresent(KeyT key) const { return t1.contains(key) || t2.contains(key); }
+
+        // current target size of T1
+        size_type target() const { return p; }
+
+    private:
+        void replace(bool inB2);
+
+    private:
+        size_type cap;
+        size_type p = 0;
+        slab_list<KeyT, Hash> t1;
+        slab_list<KeyT, Hash> t2;
+        slab_list<KeyT, Hash> b1;
+        slab_list<KeyT, Hash> b2;
+    };
+
+    template <typename KeyT, typename Hash>
+    bool arc_cache<KeyT, Hash>::lookup_update(KeyT key, hash_type h) {
+        if (auto hit = t2.find(key, h); hit != t2.npos) {
+            t2.move_to_front(hit);
+            return true;
+        }
+        if (auto hit = t1.find(key, h); hit != t1.npos) {
+            t1.erase(hit);
+            t2.push_front(key, h);
+            return true;
+        }
+
+        if (cap == 0)
+            return false;
+
+        if (auto ghost = b1.find(key, h); ghost != b1.npos) {
+            p = std::min(cap, p + std::max<size_type>(b2.size() / b1.size(), 1));
+            b1.erase(ghost);
+            replace(false);
+            t2.push_front(key, h);
+            return false;
+        }
+        if (auto ghost = b2.find(key, h); ghost != b2.npos) {
+            size_type delta = std::max<size_type>(b1.size() / b2.size(), 1);
+            p = p > delta ? p - delta : 0;
+            b2.erase(ghost);
+            replace(true);
+            t2.push_front(key, h);
+            return false;
+        }
+
+        size_type l1 = t1.size() + b1.size();
+        size_type total = l1 + t2.size() + b2.size();
+        if (l1 == cap) {
+            if (t1.size() < cap) {
+                b1.pop_back();
+                replace(false);
+            } else {
+                t1.pop_back();
+            }
+        } else if (total >= cap) {
+            if (total == 2 * cap)
+                b2.pop_back();
+            replace(false);
+        }
+
+        t1.push_front(key, h);
+        return false;
+    }
+
+    // Makes room in T1 + T2 by demoting an LRU page to its ghost list. The key
+    // being inserted was already removed from its ghost list, so inB2 tells
+    // whether it came from B2.
+    template <typename KeyT, typename Hash>
+    void arc_cache<KeyT, Hash>::replace(bool inB2) {
+        if (!full())
+            return;
+
+        if (!t1.empty() && (t1.size() > p || (inB2 && t1.size() == p))) {
+            b1.push_front(t1.pop_back());
+            return;
+        }
+        b2.push_front(t2.pop_back());
+    }
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "batch.hpp"
+#include "slab.hpp"
+#include "stats.hpp"
+
+namespace caches {
+    // A single-queue cache assembled from parts chosen at compile time:
+    //  - Storage keeps the keys in nodes addressed by 32-bit indices; it is
+    //    rebound so that every node also carries EvictionPolicy::node_data.
+    //  - Index maps a key to its node (open_index by default; direct_index for
+    //    dense integer keys, see dense_cache).
+    //  - EvictionPolicy orders the nodes and names the victim. It sees the
+    //    storage in every hook, so list links or counters live in the node:
+    //      inserted(storage, i), accessed(storage, i), erased(storage, i)
+    //      victim(storage) -> index of the next node to evict
+    //      clear(), and optionally reserve(capacity) and bypassed(), the
+    //      latter for a miss that is not cached because the capacity is 0.
+    //  - Stats gets the hooks of stats.hpp; everything is reported under the
+    //    hot queue.
+    // All calls are resolved statically, so a policy costs what its hooks do.
+    template <typename EvictionPolicy, typename Storage = slab_storage<int>,
+              typename Index = open_index<typename Storage::key_type>, typename Stats = no_stats>
+    class basic_cache {
+    public:
+        using key_type = typename Storage::key_type;
+        using storage_type = typename Storage::template rebind<typename EvictionPolicy::node_data>;
+        using size_type = size_t;
+        using index_type = typename storage_type::index_type;
+        using hash_type = typename Index::hash_type;
+
+        static constexpr index_type npos = storage_type::npos;
+
+    public:
+        explicit basic_cache(size_type capacity, EvictionPolicy policy = EvictionPolicy{}, Stats stats = Stats{}) :
+            cap_{capacity}, storage_{capacity}, index_{capacity}, policy_{std::move(policy)}, stats_{std::move(stats)} {
+            reserve_policy(capacity);
+        }
+
+        // for indexes that are not sized by the capacity, such as direct_index
+        basic_cache(size_type capacity, Index index, EvictionPolicy policy = EvictionPolicy{}, Stats stats = Stats{}) :
+            cap_{capacity}, storage_{capacity}, index_{std::move(index)}, policy_{std::move(policy)}, stats_{std::move(stats)} {
+            index_.reserve(capacity);
+            reserve_policy(capacity);
+        }
+
+        size_type size() const { return storage_.size(); }
+        size_type capacity() const { return cap_; }
+        bool empty() const { return size() == 0; }
+        bool full() const { return size() == cap_; }
+
+        hash_type hash(const key_type& key) const { return index_.hash(key); }
+
+        bool isPresent(const key_type& key) const { return find(key, hash(key)) != npos; }
+        bool isPresent(const key_type& key, hash_type h) const { return find(key, h) != npos; }
+
+        // The node of a cached key, or npos. Nodes are reused as keys come and
+        // go, so they stay below the largest capacity the cache had.
+        index_type node_of(const key_type& key) const { return find(key, hash(key)); }
+
+        bool lookup_update(const key_type& key) { return lookup_update(key, hash(key)); }
+
+        // h must be hash(key)
+        bool lookup_update(const key_type& key, hash_type h) {
+            [[maybe_unused]] auto scope = stats_.lookup();
+
+            index_type i = find(key, h);
+            if (i != npos) {
+                policy_.accessed(storage_, i);
+                stats_.hit(cache_queue::hot);
+                return true;
+            }
+
+            if (cap_ == 0) {
+                if constexpr (requires { policy_.bypassed(); })
+                    policy_.bypassed();
+                return false;
+            }
+
+            if (full())
+                evict();
+            else
+                stats_.admission(cache_queue::hot);
+            insert(key, h);
+            return false;
+        }
+
+        size_type lookup_update_batch(std::span<const key_type> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        // a hit if the key is cached; a miss admits nothing
+        bool touch(const key_type& key, hash_type h) {
+            index_type i = find(key, h);
+            if (i == npos)
+                return false;
+            policy_.accessed(storage_, i);
+            return true;
+        }
+
+        void prefetch(hash_type h) const { index_.prefetch(h); }
+        void prefetch_entry(const key_type& key, hash_type h) const {
+            if (auto i = find(key, h); i != npos)
+                storage_.prefetch(i);
+        }
+
+        void remove(const key_type& key) {
+            if (auto i = find(key, hash(key)); i != npos)
+                erase(i);
+        }
+
+        // the key the next insertion into a full cache would evict
+        const key_type& victim_key() const { return storage_.key(policy_.victim(storage_)); }
+
+        // Changes the capacity; shrinking evicts victims until the keys fit.
+        void resize(size_type capacity) {
+            while (size() > capacity)
+                evict();
+            storage_.reserve(capacity);
+            index_.reserve(capacity);
+            reserve_policy(capacity);
+            cap_ = capacity;
+        }
+
+        void clear() {
+            storage_.clear();
+            index_.clear();
+            policy_.clear();
+        }
+
+        // Calls f(key, node) for every cached key, in slab order.
+        template <typename F>
+        void for_each(F f) const {
+            for (size_type i = 0; i < storage_.slab_size(); i++) {
+                auto node = static_cast<index_type>(i);
+                // released nodes keep their old key, but the index no longer points at them
+                if (find(storage_.key(node), hash(storage_.key(node))) == node)
+                    f(storage_.key(node), node);
+            }
+        }
+
+        // Calls f(key) for every cached key, from the next victim to the most
+        // recently used one, for policies that keep a single order.
+        template <typename F>
+        void for_each_by_age(F f) const
+            requires requires(const EvictionPolicy& p, const storage_type& s) { p.for_each_by_age(s, [](index_type) {}); }
+        {
+            policy_.for_each_by_age(storage_, [&](index_type i) { f(storage_.key(i)); });
+        }
+
+        const EvictionPolicy& policy() const { return policy_; }
+        const Stats& stats() const { return stats_; }
+
+    private:
+        index_type find(const key_type& key, hash_type h) const {
+            return index_.find(key, h, [this](index_type i) -> const key_type& { return storage_.key(i); });
+        }
+
+        void insert(const key_type& key, hash_type h) {
+            index_type i = storage_.allocate(key, static_cast<std::uint32_t>(h));
+            index_.insert(h, i);
+            policy_.inserted(storage_, i);
+        }
+
+        void erase(index_type i) {
+            policy_.erased(storage_, i);
+            index_.erase(storage_.tag(i), i);
+            storage_.release(i);
+        }
+
+        void evict() {
+            erase(policy_.victim(storage_));
+            stats_.eviction(cache_queue::hot);
+        }
+
+        void reserve_policy(size_type capacity) {
+            if constexpr (requires { policy_.reserve(capacity); })
+                policy_.reserve(capacity);
+        }
+
+    private:
+        size_type cap_;
+        storage_type storage_;
+        Index index_;
+        EvictionPolicy policy_;
+        [[no_unique_address]] Stats stats_;
+    };
+
+    // Evicts the least recently used key.
+    class lru_policy {
+    public:
+        using index_type = std::uint32_t;
+        using node_data = list_links;
+
+    public:
+        template <typename Storage>
+        void inserted(Storage& s, index_type i) { order_.link_front(s, i); }
+
+        template <typename Storage>
+        void accessed(Storage& s, index_type i) { order_.move_to_front(s, i); }
+
+        template <typename Storage>
+        void erased(Storage& s, index_type i) { order_.unlink(s, i); }
+
+        template <typename Storage>
+        index_type victim(const Storage&) const { return order_.back(); }
+
+        void clear() { order_.clear(); }
+
+        // Calls f(node) from the victim to the most recently used node.
+        template <typename Storage, typename F>
+        void for_each_by_age(const Storage& s, F f) const {
+            for (index_type i = order_.back(); i != intrusive_list::npos; i = s.data(i).prev)
+                f(i);
+        }
+
+    protected:
+        intrusive_list order_;
+    };
+
+    // Evicts the oldest key; hits do not reorder anything.
+    class fifo_policy : public lru_policy {
+    public:
+        template <typename Storage>
+        void accessed(Storage&, index_type) {}
+    };
+
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class fifo_cache : public basic_cache<fifo_policy, slab_storage<KeyT>, open_index<KeyT, Hash>> {
+    public:
+        using size_type = size_t;
+    public:
+        fifo_cache(size_type capacity) : basic_cache<fifo_policy, slab_storage<KeyT>, open_index<KeyT, Hash>>(capacity) {}
+    };
+
+    // Segmented LRU, the 2Q idea in one cache: new keys enter a probation
+    // segment, a hit there moves them to the protected segment, and keys
+    // pushed out of protected go back to probation instead of leaving.
+    // Victims come from probation, so a scan cannot flush protected keys.
+    class slru_policy {
+    public:
+        using index_type = std::uint32_t;
+
+        struct node_data : list_links {
+            bool protected_key;
+        };
+
+    public:
+        explicit slru_policy(double protected_fraction = 0.8) : fraction_{protected_fraction} {}
+
+        void reserve(size_t capacity) { protected_cap_ = static_cast<size_t>(capacity * fraction_); }
+
+        template <typename Storage>
+        void inserted(Storage& s, index_type i) {
+            s.data(i).protected_key = false;
+            probation_.link_front(s, i);
+        }
+
+        template <typename Storage>
+        void accessed(Storage& s, index_type i) {
+            if (s.data(i).protected_key) {
+                protected_.move_to_front(s, i);
+                return;
+            }
+            probation_.unlink(s, i);
+            protected_.link_front(s, i);
+            s.data(i).protected_key = true;
+            if (++protected_size_ > protected_cap_) {
+                index_type demoted = protected_.back();
+                protected_.unlink(s, demoted);
+                protected_size_--;
+                s.data(demoted).protected_key = false;
+                probation_.link_front(s, demoted);
+            }
+        }
+
+        template <typename Storage>
+        void erased(Storage& s, index_type i) {
+            if (s.data(i).protected_key) {
+                protected_.unlink(s, i);
+                protected_size_--;
+            } else {
+                probation_.unlink(s, i);
+            }
+        }
+
+        template <typename Storage>
+        index_type victim(const Storage&) const {
+            return probation_.back() != intrusive_list::npos ? probation_.back() : protected_.back();
+        }
+
+        void clear() {
+            probation_.clear();
+            protected_.clear();
+            protected_size_ = 0;
+        }
+
+    private:
+        double fraction_;
+        size_t protected_cap_ = 0;
+        size_t protected_size_ = 0;
+        intrusive_list probation_;
+        intrusive_list protected_;
+    };
+
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class slru_cache : public basic_cache<slru_policy, slab_storage<KeyT>, open_index<KeyT, Hash>> {
+    public:
+        using size_type = size_t;
+    public:
+        slru_cache(size_type capacity) : basic_cache<slru_policy, slab_storage<KeyT>, open_index<KeyT, Hash>>(capacity) {}
+    };
+
+    // Any policy over integer keys in [0, universe), indexed by direct_index
+    // instead of a hash table.
+    template <typename KeyT = int, typename EvictionPolicy = lru_policy>
+    class dense_cache : public basic_cache<EvictionPolicy, slab_storage<KeyT>, direct_index<KeyT>> {
+    public:
+        using size_type = size_t;
+    public:
+        dense_cache(size_type capacity, key_universe universe) :
+            basic_cache<EvictionPolicy, slab_storage<KeyT>, direct_index<KeyT>>(capacity, direct_index<KeyT>(universe)) {}
+    };
+}
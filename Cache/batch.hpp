@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+namespace caches {
+    // Keys per prefetch window: enough independent misses in flight to cover
+    // DRAM latency, few enough that the lines are still in L1 when used.
+    inline constexpr size_t batch_window = 16;
+
+    // Body of the lookup_update_batch methods. Per window of keys, a first
+    // pass hashes every key and prefetches its index slot, a second probes the
+    // (now cached) slots and prefetches the nodes they point to, and a third
+    // runs lookup_update(key, h) in order. Results are exactly those of calling
+    // lookup_update key by key. Cache provides hash(key), prefetch(h),
+    // prefetch_entry(key, h) and lookup_update(key, h). hits is either empty
+    // or as long as keys; returns the number of hits.
+    template <typename Cache, typename KeyT>
+    size_t apply_batch(Cache& cache, std::span<const KeyT> keys, std::span<bool> hits) {
+        if (!hits.empty() && hits.size() != keys.size())
+            throw std::invalid_argument("hits must be empty or as long as the batch");
+
+        std::uint64_t h[batch_window];
+        size_t total = 0;
+        for (size_t base = 0; base < keys.size(); base += batch_window) {
+            size_t n = std::min(batch_window, keys.size() - base);
+            const KeyT* window = keys.data() + base;
+
+            for (size_t i = 0; i < n; i++) {
+                h[i] = cache.hash(window[i]);
+                cache.prefetch(h[i]);
+            }
+            for (size_t i = 0; i < n; i++)
+                cache.prefetch_entry(window[i], h[i]);
+            for (size_t i = 0; i < n; i++) {
+                bool hit = cache.lookup_update(window[i], h[i]);
+                total += hit;
+                if (!hits.empty())
+                    hits[base + i] = hit;
+            }
+        }
+        return total;
+    }
+}
@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+
+#include "perfectcache.hpp"
+#include "slab.hpp"
+#include "workloads.hpp"
+
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using namespace caches;
+
+namespace {
+    // perfect_cache as it was before the heap: every eviction scans the whole
+    // resident set for the furthest next use
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class scan_perfect_cache {
+    public:
+        using size_type = size_t;
+
+    public:
+        template <typename It>
+        scan_perfect_cache(size_type size, It begin, It end) : size_{size}, cache_{size} {
+            size_type i = 0;
+            for (; begin != end; ++begin, ++i)
+                mp_[*begin].push_back(i);
+        }
+
+        bool lookup_update(const KeyT& key) {
+            auto h = cache_.hash(key);
+            if (cache_.find(key, h) == cache_.npos) {
+                if (cache_.size() == size_)
+                    erase();
+                cache_.push_front(key, h);
+                mp_[key].pop_front();
+                return false;
+            }
+
+            mp_[key].pop_front();
+            return true;
+        }
+
+    private:
+        void erase() {
+            auto elem = cache_.npos;
+            size_type max = 0;
+            for (auto it = cache_.front(); it != cache_.npos; it = cache_.next(it)) {
+                auto find = mp_.find(cache_.key(it));
+                if (find->second.empty()) {
+                    cache_.erase(it);
+                    return;
+                }
+
+                if (elem == cache_.npos || max < find->second[0]) {
+                    elem = it;
+                    max = find->second[0];
+                }
+            }
+            cache_.erase(elem);
+        }
+
+    private:
+        size_type size_;
+        std::unordered_map<KeyT, std::deque<size_type>, Hash> mp_;
+        slab_list<KeyT, Hash> cache_;
+    };
+
+    const std::vector<int>& trace(size_t n) {
+        static std::map<size_t, std::vector<int>> traces;
+        auto& keys = traces[n];
+        if (keys.empty())
+            keys = workloads::zipf(n, n / 4, 0.8);
+        return keys;
+    }
+
+    // one iteration replays the whole trace; building the oracle is not timed
+    template <typename Cache>
+    void BM_belady(benchmark::State& state) {
+        const auto& keys = trace(state.range(0));
+        size_t capacity = state.range(1);
+        int64_t hits = 0;
+
+        for (auto _ : state) {
+            state.PauseTiming();
+            Cache cache(capacity, keys.begin(), keys.end());
+            state.ResumeTiming();
+
+            hits = 0;
+            for (int key : keys)
+                hits += cache.lookup_update(key);
+            benchmark::DoNotOptimize(hits);
+        }
+
+        state.SetItemsProcessed(state.iterations() * keys.size());
+        state.counters["hit_ratio"] = static_cast<double>(hits) / keys.size();
+    }
+
+    // building the oracle alone; 0 threads is the sequential backward pass
+    void BM_next_use(benchmark::State& state) {
+        const auto& keys = trace(state.range(0));
+        auto threads = static_cast<size_t>(state.range(1));
+        for (auto _ : state) {
+            auto next_use = threads == 0 ? compute_next_use(keys.begin(), keys.end())
+                                         : compute_next_use_parallel<std::uint32_t, int>(keys, threads);
+            benchmark::DoNotOptimize(next_use.data());
+        }
+        state.SetItemsProcessed(state.iterations() * keys.size());
+    }
+}
+
+// the scan is O(capacity) per miss, so only the small sizes finish in reasonable time
+BENCHMARK_TEMPLATE(BM_belady, scan_perfect_cache<int>)
+    ->ArgsProduct({{1 << 20}, {1 << 10, 1 << 14}})
+    ->Args({1 << 24, 1 << 10})
+    ->Unit(benchmark::kMillisecond)->Iterations(1);
+
+BENCHMARK_TEMPLATE(BM_belady, perfect_cache<int>)
+    ->ArgsProduct({{1 << 20, 1 << 24, 100'000'000}, {1 << 10, 1 << 14, 1 << 20}})
+    ->Unit(benchmark::kMillisecond)->Iterations(1);
+
+BENCHMARK(BM_next_use)
+    ->ArgsProduct({{1 << 24, 100'000'000}, {0, 1, 2, 4, 8, 16, 32}})
+    ->Unit(benchmark::kMillisecond)->Iterations(1)->UseRealTime();
+
+BENCHMARK_MAIN();
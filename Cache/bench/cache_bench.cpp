@@ -0,0 +1,147 @@
+#include <benchmark/benchmark.h>
+
+#include "arc.hpp"
+#include "basic_cache.hpp"
+#include "cache.hpp"
+#include "lirs.hpp"
+#include "lrucache.hpp"
+#include "perfectcache.hpp"
+#include "s3fifo.hpp"
+#include "sizedcache.hpp"
+#include "tinylfu.hpp"
+#include "twoqueue.hpp"
+#include "workloads.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace caches;
+
+namespace {
+    struct workload {
+        std::string name;
+        std::function<std::vector<int>(size_t capacity)> make;
+    };
+
+    // traces are at least four times the capacity long and the key spaces are
+    // a few times larger than the cache, so every policy has to evict
+    size_t length(size_t capacity) { return std::max<size_t>(1 << 20, 4 * capacity); }
+
+    const std::vector<workload>& all_workloads() {
+        static const std::vector<workload> all{
+            {"zipf-0.6", [](size_t c) { return workloads::zipf(length(c), 4 * c, 0.6); }},
+            {"zipf-0.8", [](size_t c) { return workloads::zipf(length(c), 4 * c, 0.8); }},
+            {"zipf-0.99", [](size_t c) { return workloads::zipf(length(c), 4 * c, 0.99); }},
+            {"zipf-1.2", [](size_t c) { return workloads::zipf(length(c), 4 * c, 1.2); }},
+            {"scan", [](size_t c) { return workloads::scan(length(c)); }},
+            {"loop", [](size_t c) { return workloads::loop(length(c), c + c / 4); }},
+            {"scan-hot", [](size_t c) { return workloads::scan_hot(length(c), c / 2, 0.5); }},
+        };
+        return all;
+    }
+
+    // Benchmarks are registered workload by workload, so consecutive runs
+    // share one trace and only the last one is kept in memory.
+    const std::vector<int>& trace(size_t w, size_t capacity) {
+        static size_t cachedWorkload = ~size_t{0}, cachedCapacity = 0;
+        static std::vector<int> keys;
+        if (w != cachedWorkload || capacity != cachedCapacity) {
+            keys = all_workloads()[w].make(capacity);
+            cachedWorkload = w;
+            cachedCapacity = capacity;
+        }
+        return keys;
+    }
+
+    template <typename Cache>
+    Cache make_cache(size_t capacity, const std::vector<int>& keys) {
+        if constexpr (std::constructible_from<Cache, size_t, std::vector<int>::const_iterator, std::vector<int>::const_iterator>)
+            return Cache(capacity, keys.begin(), keys.end());
+        else if constexpr (std::constructible_from<Cache, size_t, key_universe>)
+            return Cache(capacity, key_universe{static_cast<size_t>(*std::max_element(keys.begin(), keys.end())) + 1});
+        else
+            return Cache(capacity);
+    }
+
+    // one iteration replays the whole trace through a cold cache; building
+    // the cache (and the oracle of perfect_cache) is not timed
+    // 0 replays key by key, otherwise through lookup_update_batch
+    template <typename Cache, size_t Batch = 0>
+    void BM_replay(benchmark::State& state, size_t w, size_t capacity) {
+        const auto& keys = trace(w, capacity);
+        int64_t hits = 0;
+
+        for (auto _ : state) {
+            state.PauseTiming();
+            {
+                Cache cache = make_cache<Cache>(capacity, keys);
+                state.ResumeTiming();
+
+                hits = 0;
+                if constexpr (Batch == 0) {
+                    for (int key : keys)
+                        hits += cache.lookup_update(key);
+                } else {
+                    for (size_t i = 0; i < keys.size(); i += Batch)
+                        hits += cache.lookup_update_batch(std::span<const int>(keys).subspan(i, std::min(Batch, keys.size() - i)));
+                }
+                benchmark::DoNotOptimize(hits);
+                state.PauseTiming();
+            }
+            state.ResumeTiming();
+        }
+
+        state.SetItemsProcessed(state.iterations() * keys.size());
+        state.counters["per_op"] = benchmark::Counter(static_cast<double>(keys.size()),
+            benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+        state.counters["hit_ratio"] = static_cast<double>(hits) / keys.size();
+    }
+
+    template <typename Cache, size_t Batch = 0>
+    void add(const std::string& policy, size_t w, size_t capacity) {
+        auto name = policy + "/" + all_workloads()[w].name + "/" + std::to_string(capacity);
+        benchmark::RegisterBenchmark(name.c_str(), BM_replay<Cache, Batch>, w, capacity)
+            ->Unit(benchmark::kMillisecond)->MinTime(0.2);
+    }
+}
+
+// ns/op and hit ratio of every policy on every workload at capacities from 1K
+// to 16M; use --benchmark_filter to pick a subset, e.g. 'lru2/zipf-0.99/'
+int main(int argc, char** argv) {
+    for (size_t w = 0; w < all_workloads().size(); w++) {
+        for (size_t capacity = 1 << 10; capacity <= (1 << 24); capacity *= 4) {
+            add<lru_cache<int>>("lru", w, capacity);
+            add<dense_cache<int>>("lru-dense", w, capacity);
+            add<fifo_cache<int>>("fifo", w, capacity);
+            add<slru_cache<int>>("slru", w, capacity);
+            add<lru_2_cache<int>>("lru2", w, capacity);
+            add<adaptive_lru_2_cache<int>>("lru2-adaptive", w, capacity);
+            add<two_q_cache<int>>("2q", w, capacity);
+            add<arc_cache<int>>("arc", w, capacity);
+            add<s3fifo_cache<int>>("s3fifo", w, capacity);
+            add<lirs_cache<int>>("lirs", w, capacity);
+            add<tinylfu_cache<int>>("tinylfu", w, capacity);
+            add<gdsf_cache<int>>("gdsf", w, capacity);
+            add<perfect_cache<int>>("perfect", w, capacity);
+            // same policies fed 128 keys at a time
+            add<lru_cache<int>, 128>("lru-batch", w, capacity);
+            add<dense_cache<int>, 128>("lru-dense-batch", w, capacity);
+            add<lru_2_cache<int>, 128>("lru2-batch", w, capacity);
+            add<two_q_cache<int>, 128>("2q-batch", w, capacity);
+            add<arc_cache<int>, 128>("arc-batch", w, capacity);
+            add<s3fifo_cache<int>, 128>("s3fifo-batch", w, capacity);
+            add<lirs_cache<int>, 128>("lirs-batch", w, capacity);
+            add<tinylfu_cache<int>, 128>("tinylfu-batch", w, capacity);
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+}
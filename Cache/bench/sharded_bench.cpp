@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+
+#include "buffered.hpp"
+#include "cache.hpp"
+#include "shardedcache.hpp"
+#include "workloads.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace caches;
+
+namespace {
+    constexpr size_t traceSize = 1 << 22;
+    constexpr size_t keySpace = 1 << 20;
+    constexpr size_t capacity = 1 << 16;
+
+    const std::vector<int>& trace() {
+        static const std::vector<int> keys = workloads::zipf(traceSize, keySpace, 0.99);
+        return keys;
+    }
+
+    // every thread walks the shared trace from its own offset
+    template <typename F>
+    void replay(benchmark::State& state, F&& lookup) {
+        const auto& keys = trace();
+        size_t i = (traceSize / state.threads()) * state.thread_index();
+        int64_t hits = 0;
+        for (auto _ : state) {
+            hits += lookup(keys[i]);
+            i = (i + 1) & (traceSize - 1);
+        }
+        state.SetItemsProcessed(state.iterations());
+        state.counters["hit_ratio"] = benchmark::Counter(static_cast<double>(hits) / state.iterations(), benchmark::Counter::kAvgThreads);
+    }
+
+    // what the service does today: one lru_2_cache behind one mutex
+    std::unique_ptr<lru_2_cache<int>> global;
+    std::mutex globalMutex;
+
+    void BM_global_mutex(benchmark::State& state) {
+        if (state.thread_index() == 0)
+            global = std::make_unique<lru_2_cache<int>>(capacity);
+
+        replay(state, [](int key) {
+            std::lock_guard lock{globalMutex};
+            return global->lookup_update(key);
+        });
+
+        if (state.thread_index() == 0)
+            global.reset();
+    }
+
+    std::unique_ptr<sharded_lru_2_cache<int>> sharded;
+
+    void BM_sharded(benchmark::State& state) {
+        if (state.thread_index() == 0)
+            sharded = std::make_unique<sharded_lru_2_cache<int>>(capacity, state.range(0));
+
+        replay(state, [](int key) { return sharded->lookup_update(key); });
+
+        if (state.thread_index() == 0)
+            sharded.reset();
+    }
+
+    // hits probe a lock-free resident set and only append to a read buffer
+    std::unique_ptr<buffered_cache<int>> buffered;
+
+    void BM_buffered(benchmark::State& state) {
+        if (state.thread_index() == 0)
+            buffered = std::make_unique<buffered_cache<int>>(capacity, state.range(0));
+
+        replay(state, [](int key) { return buffered->lookup_update(key); });
+
+        if (state.thread_index() == 0) {
+            state.counters["dropped"] = static_cast<double>(buffered->stats().dropped);
+            buffered.reset();
+        }
+    }
+}
+
+BENCHMARK(BM_global_mutex)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_sharded)->Arg(16)->Arg(64)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_buffered)->Arg(16)->Arg(64)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_MAIN();
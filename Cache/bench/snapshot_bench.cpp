@@ -0,0 +1,46 @@
+#include <benchmark/benchmark.h>
+
+#include "cache.hpp"
+#include "snapshot.hpp"
+
+#include <cstdio>
+#include <string>
+
+using namespace caches;
+
+namespace {
+    const std::string path = "snapshot_bench.snap";
+
+    // a full cache: the first half of the keys in the candidate list, the
+    // rest in the hot one
+    lru_2_cache<int> filled(size_t capacity) {
+        lru_2_cache<int> cache(capacity);
+        for (size_t key = 0; key < capacity; key++)
+            cache.lookup_update(static_cast<int>(key));
+        return cache;
+    }
+}
+
+static void BM_save(benchmark::State& state) {
+    auto capacity = static_cast<size_t>(state.range(0));
+    auto cache = filled(capacity);
+    for (auto _ : state)
+        save_snapshot(cache, path);
+    state.SetItemsProcessed(state.iterations() * capacity);
+    std::remove(path.c_str());
+}
+
+static void BM_restore(benchmark::State& state) {
+    auto capacity = static_cast<size_t>(state.range(0));
+    save_snapshot(filled(capacity), path);
+    lru_2_cache<int> cache(capacity);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(restore_snapshot(cache, path));
+    state.SetItemsProcessed(state.iterations() * capacity);
+    std::remove(path.c_str());
+}
+
+BENCHMARK(BM_save)->Arg(1 << 20)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_restore)->Arg(1 << 20)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace workloads {
+    using size_type = size_t;
+
+    // Zipf over [0, n) with exponent alpha, sampled by rejection-inversion
+    // (Hormann & Derflinger), so it needs no O(n) table even for huge key spaces.
+    class zipf_distribution {
+    public:
+        zipf_distribution(size_type n, double alpha) : n_{static_cast<double>(n)}, alpha_{alpha} {
+            h_x1_ = h(1.5) - 1.0;
+            h_n_ = h(n_ + 0.5);
+            s_ = 2.0 - h_inv(h(2.5) - std::exp(-alpha_ * std::log(2.0)));
+        }
+
+        template <typename Gen>
+        size_type operator()(Gen& gen) {
+            std::uniform_real_distribution<double> dist(0.0, 1.0);
+            for (;;) {
+                double u = h_n_ + dist(gen) * (h_x1_ - h_n_);
+                double x = h_inv(u);
+                double k = std::floor(x + 0.5);
+                if (k < 1.0)
+                    k = 1.0;
+                else if (k > n_)
+                    k = n_;
+                if (k - x <= s_ || u >= h(k + 0.5) - std::exp(-alpha_ * std::log(k)))
+                    return static_cast<size_type>(k) - 1;
+            }
+        }
+
+    private:
+        // helper1/helper2 keep the alpha -> 1 limit numerically stable
+        static double helper1(double x) { return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x)); }
+        static double helper2(double x) { return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x)); }
+
+        double h(double x) const {
+            double log_x = std::log(x);
+            return helper2((1.0 - alpha_) * log_x) * log_x;
+        }
+
+        double h_inv(double x) const {
+            double t = x * (1.0 - alpha_);
+            if (t < -1.0)
+                t = -1.0;
+            return std::exp(helper1(t) * x);
+        }
+
+    private:
+        double n_, alpha_;
+        double h_x1_, h_n_, s_;
+    };
+
+    inline std::vector<int> zipf(size_type n, size_type keys, double alpha, std::uint64_t seed = 1) {
+        std::mt19937_64 gen(seed);
+        zipf_distribution dist(keys, alpha);
+        std::vector<int> trace(n);
+        for (auto& key : trace)
+            key = static_cast<int>(dist(gen));
+        return trace;
+    }
+
+    // every request is a new key
+    inline std::vector<int> scan(size_type n, int first = 0) {
+        std::vector<int> trace(n);
+        for (size_type i = 0; i < n; i++)
+            trace[i] = first + static_cast<int>(i);
+        return trace;
+    }
+
+    // cycles over the same `length` keys
+    inline std::vector<int> loop(size_type n, size_type length) {
+        std::vector<int> trace(n);
+        for (size_type i = 0; i < n; i++)
+            trace[i] = static_cast<int>(i % length);
+        return trace;
+    }
+
+    // a Zipf-distributed hot set of `hot` keys interleaved with a sequential
+    // scan over keys that never repeat; scan_share is the fraction of scan requests
+    inline std::vector<int> scan_hot(size_type n, size_type hot, double scan_share, std::uint64_t seed = 1) {
+        std::mt19937_64 gen(seed);
+        zipf_distribution dist(hot, 0.9);
+        std::bernoulli_distribution is_scan(scan_share);
+        std::vector<int> trace(n);
+        int next = static_cast<int>(hot);
+        for (auto& key : trace)
+            key = is_scan(gen) ? next++ : static_cast<int>(dist(gen));
+        return trace;
+    }
+
+    inline std::vector<int> uniform(size_type n, size_type keys, std::uint64_t seed = 1) {
+        std::mt19937_64 gen(seed);
+        std::uniform_int_distribution<size_type> dist(0, keys - 1);
+        std::vector<int> trace(n);
+        for (auto& key : trace)
+            key = static_cast<int>(dist(gen));
+        return trace;
+    }
+}
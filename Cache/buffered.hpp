@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "basic_cache.hpp"
+#include "slab.hpp"
+
+// Caffeine-style concurrent reads. Every shard keeps its policy exact behind
+// a mutex, plus a lock-free copy of the resident set that hits are answered
+// from. A hit only appends the key to a read buffer; the buffered hits are
+// replayed into the policy in batches, by whoever holds the shard lock next.
+namespace caches {
+    // Open-addressing set of 64-bit hashes that readers probe without a lock
+    // while one writer (holding the shard lock) inserts and erases. Deletion
+    // shifts entries back, so a concurrent probe may miss a hash that is being
+    // moved; it never reports a hash that is not in the set. 0 marks an empty
+    // slot, so the hash 0 has a flag of its own.
+    class concurrent_hash_set {
+    public:
+        using size_type = size_t;
+
+    public:
+        explicit concurrent_hash_set(size_type capacity) {
+            size_type n = 16;
+            while (n < 2 * capacity)
+                n *= 2;
+            slots_ = std::make_unique<std::atomic<std::uint64_t>[]>(n);
+            mask_ = n - 1;
+        }
+
+        bool contains(std::uint64_t h) const {
+            if (h == 0)
+                return zero_.load(std::memory_order_relaxed);
+            for (size_type i = h & mask_;; i = (i + 1) & mask_) {
+                std::uint64_t v = slots_[i].load(std::memory_order_relaxed);
+                if (v == h)
+                    return true;
+                if (v == 0)
+                    return false;
+            }
+        }
+
+        void insert(std::uint64_t h) {
+            if (h == 0) {
+                zero_.store(true, std::memory_order_relaxed);
+                return;
+            }
+            size_type i = h & mask_;
+            while (slots_[i].load(std::memory_order_relaxed) != 0)
+                i = (i + 1) & mask_;
+            slots_[i].store(h, std::memory_order_release);
+        }
+
+        void erase(std::uint64_t h) {
+            if (h == 0) {
+                zero_.store(false, std::memory_order_relaxed);
+                return;
+            }
+            size_type i = h & mask_;
+            while (slots_[i].load(std::memory_order_relaxed) != h)
+                i = (i + 1) & mask_;
+
+            // backward shift, as in open_index::erase
+            for (size_type j = (i + 1) & mask_;; j = (j + 1) & mask_) {
+                std::uint64_t v = slots_[j].load(std::memory_order_relaxed);
+                if (v == 0)
+                    break;
+                size_type home = v & mask_;
+                if (((j - home) & mask_) >= ((j - i) & mask_)) {
+                    slots_[i].store(v, std::memory_order_release);
+                    i = j;
+                }
+            }
+            slots_[i].store(0, std::memory_order_release);
+        }
+
+    private:
+        std::unique_ptr<std::atomic<std::uint64_t>[]> slots_;
+        size_type mask_;
+        std::atomic<bool> zero_{false};
+    };
+
+    // Bounded ring of keys with many writers and one reader (the lock holder).
+    // A write into a full ring, or one that loses a race for its slot, is
+    // dropped: the policy misses one access but readers never wait.
+    template <typename KeyT, size_t Size = 32>
+    class read_buffer {
+        static_assert((Size & (Size - 1)) == 0, "read_buffer size must be a power of two");
+
+    public:
+        // false if the key was dropped
+        bool push(KeyT key) {
+            std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) >= Size)
+                return false;
+            if (!tail_.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+                return false;
+            auto& s = slots_[tail & (Size - 1)];
+            s.key.store(key, std::memory_order_relaxed);
+            s.ready.store(true, std::memory_order_release);
+            return true;
+        }
+
+        bool full() const {
+            return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_relaxed) >= Size;
+        }
+
+        // Passes the buffered keys to f. A slot claimed but not yet written
+        // stops the drain; it is picked up by the next one.
+        template <typename F>
+        void drain(F f) {
+            std::uint64_t head = head_.load(std::memory_order_relaxed);
+            std::uint64_t tail = tail_.load(std::memory_order_acquire);
+            for (; head != tail; head++) {
+                auto& s = slots_[head & (Size - 1)];
+                if (!s.ready.load(std::memory_order_acquire))
+                    break;
+                f(s.key.load(std::memory_order_relaxed));
+                s.ready.store(false, std::memory_order_relaxed);
+            }
+            head_.store(head, std::memory_order_release);
+        }
+
+    private:
+        struct slot {
+            std::atomic<KeyT> key{};
+            std::atomic<bool> ready{false};
+        };
+
+        alignas(64) std::atomic<std::uint64_t> head_{0};
+        alignas(64) std::atomic<std::uint64_t> tail_{0};
+        slot slots_[Size];
+    };
+
+    // Sharded cache with lock-free hits. A lookup probes the shard's resident
+    // set without locking; a hit is recorded in one of the shard's read
+    // buffers (picked per thread) and returns. Misses take the shard lock,
+    // drain the buffers into the EvictionPolicy (any basic_cache policy:
+    // lru_policy, slru_policy for 2Q-style segments, ...) and then insert,
+    // evicting as the policy decides. A full buffer is drained by the thread
+    // that fills it if the lock is free, and dropped otherwise.
+    //
+    // With a single thread nothing is dropped and every buffered hit is
+    // applied before the next eviction, so the hits are exactly those of the
+    // policy; under contention dropped and delayed hits cost some accuracy,
+    // which stats() reports. The resident set identifies keys by mix_hash of
+    // the key itself, a bijection on 64 bits, so a hit is never reported for a
+    // key that is not resident whatever Hash the policy index uses.
+    template <typename KeyT = int, typename EvictionPolicy = lru_policy, typename Hash = std::hash<KeyT>>
+    class buffered_cache {
+        static_assert(std::is_integral_v<KeyT>, "buffered_cache keeps integral keys in its lock-free buffers");
+        static_assert(sizeof(KeyT) <= sizeof(std::uint64_t), "the resident set identifies keys by 64 bits");
+
+    public:
+        using size_type = size_t;
+
+        static constexpr size_type stripes = 4;
+
+        struct statistics {
+            size_type hits = 0;
+            size_type misses = 0;
+            // hits dropped from a full read buffer, never seen by the policy
+            size_type dropped = 0;
+
+            size_type lookups() const { return hits + misses; }
+            double hit_ratio() const { return lookups() ? static_cast<double>(hits) / lookups() : 0.0; }
+        };
+
+    public:
+        buffered_cache(size_type capacity, size_type shards = 16) : count_{shards} {
+            if (shards == 0)
+                throw std::invalid_argument("buffered_cache needs at least one shard");
+
+            shards_ = std::make_unique<shard[]>(shards);
+            for (size_type i = 0; i < shards; i++)
+                shards_[i].init(capacity / shards + (i < capacity % shards));
+        }
+
+        bool lookup_update(KeyT key) {
+            std::uint64_t id = resident_id(key);
+            shard& s = shards_[index_of(id)];
+
+            if (s.resident->contains(id)) {
+                record(s, key);
+                s.hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            std::lock_guard lock{s.mutex};
+            drain(s);
+            bool hit = miss(s, key, id);
+            (hit ? s.hits : s.misses).fetch_add(1, std::memory_order_relaxed);
+            return hit;
+        }
+
+        bool isPresent(KeyT key) const {
+            std::uint64_t id = resident_id(key);
+            return shards_[index_of(id)].resident->contains(id);
+        }
+
+        // applies every buffered hit now
+        void maintenance() {
+            for (size_type i = 0; i < count_; i++) {
+                std::lock_guard lock{shards_[i].mutex};
+                drain(shards_[i]);
+            }
+        }
+
+        size_type shard_count() const { return count_; }
+
+        statistics stats() const {
+            statistics total;
+            for (size_type i = 0; i < count_; i++) {
+                total.hits += shards_[i].hits.load(std::memory_order_relaxed);
+                total.misses += shards_[i].misses.load(std::memory_order_relaxed);
+                total.dropped += shards_[i].dropped.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+    private:
+        using policy_cache = basic_cache<EvictionPolicy, slab_storage<KeyT>, open_index<KeyT, Hash>>;
+
+        struct alignas(64) shard {
+            std::mutex mutex;
+            std::optional<policy_cache> cache;
+            std::optional<concurrent_hash_set> resident;
+            read_buffer<KeyT> buffers[stripes];
+            std::atomic<size_type> hits{0};
+            std::atomic<size_type> misses{0};
+            std::atomic<size_type> dropped{0};
+
+            void init(size_type capacity) {
+                cache.emplace(capacity);
+                resident.emplace(capacity);
+            }
+        };
+
+        void record(shard& s, KeyT key) {
+            auto& buffer = s.buffers[stripe()];
+            if (!buffer.push(key))
+                s.dropped.fetch_add(1, std::memory_order_relaxed);
+            if (!buffer.full())
+                return;
+            if (std::unique_lock lock{s.mutex, std::try_to_lock})
+                drain(s);
+        }
+
+        // called under the shard lock: replays the buffered hits of resident keys
+        void drain(shard& s) {
+            for (auto& buffer : s.buffers)
+                buffer.drain([&](KeyT key) { s.cache->touch(key, s.cache->hash(key)); });
+        }
+
+        // called under the shard lock; the key may have been admitted since the probe
+        bool miss(shard& s, KeyT key, std::uint64_t id) {
+            auto& cache = *s.cache;
+            auto h = cache.hash(key);
+            if (cache.touch(key, h))
+                return true;
+            if (cache.capacity() == 0)
+                return false;
+
+            if (cache.full())
+                s.resident->erase(resident_id(cache.victim_key()));
+            // published after the policy has the key, so a reader's hit always has a node to touch
+            cache.lookup_update(key, h);
+            s.resident->insert(id);
+            return false;
+        }
+
+        // distinct for distinct keys: integral keys widen without collisions
+        static std::uint64_t resident_id(KeyT key) { return mix_hash(static_cast<std::uint64_t>(key)); }
+
+        static size_type stripe() {
+            static std::atomic<size_type> next{0};
+            thread_local size_type mine = next.fetch_add(1, std::memory_order_relaxed);
+            return mine % stripes;
+        }
+
+        size_type index_of(std::uint64_t h) const { return static_cast<size_type>(((h >> 32) * count_) >> 32); }
+
+    private:
+        size_type count_;
+        std::unique_ptr<shard[]> shards_;
+    };
+}
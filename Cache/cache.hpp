@@ -1,74 +1,235 @@
 #pragma once
 
-#include <vector>
-#include <list>
-#include <unordered_map>
+#include <algorithm>
 #include <cstddef>
+#include <functional>
+#include <span>
+#include <utility>
 
+#include "batch.hpp"
 #include "lrucache.hpp"
+#include "stats.hpp"
 
 namespace caches {
-    template<typename KeyT = int, typename Hash = std::hash<KeyT>>
+    enum class split_policy {
+        fixed,
+        // ghost hits move the candidate/hot boundary, see lru_2_cache::adapt
+        adaptive,
+    };
+
+    template<typename KeyT = int, typename Hash = std::hash<KeyT>, typename Stats = no_stats>
     class lru_2_cache {
     public:
         using size_type = size_t;
+        using hash_type = typename lru_cache<KeyT, Hash>::hash_type;
     public:
-        lru_2_cache(size_type capacity) : cap{capacity}, candidatePages{cap / 2}, hotPages{cap - (cap / 2)} {}
+        lru_2_cache(size_type capacity, Stats stats = Stats{}) :
+            lru_2_cache(capacity, capacity / 2, split_policy::fixed, std::move(stats)) {}
+
+        // candidates is the (initial) capacity of the candidate list, the hot
+        // list gets the rest; split_tune finds a good value for a given trace
+        lru_2_cache(size_type capacity, size_type candidates, split_policy split = split_policy::fixed, Stats stats = Stats{}) :
+            cap{capacity},
+            adaptive{split == split_policy::adaptive && capacity >= 2},
+            candidatePages{std::min(candidates, capacity)}, hotPages{capacity - std::min(candidates, capacity)},
+            candidateGhosts{adaptive ? capacity : 0}, hotGhosts{adaptive ? capacity : 0},
+            stats_{std::move(stats)} {
+            if (adaptive) {
+                size_type c = std::clamp<size_type>(candidates, 1, capacity - 1);
+                candidatePages.resize(c);
+                hotPages.resize(capacity - c);
+            }
+        }
 
         bool full() const { return candidatePages.full() && hotPages.full(); }
 
-        bool lookup_update(KeyT key);
+        bool lookup_update(KeyT key) { return lookup_update(key, hash(key)); }
+        bool lookup_update(KeyT key, hash_type h);
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return hotPages.hash(key); }
+        void prefetch(hash_type h) const {
+            hotPages.prefetch(h);
+            candidatePages.prefetch(h);
+        }
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            hotPages.prefetch_entry(key, h);
+            candidatePages.prefetch_entry(key, h);
+        }
 
         bool isPresent(KeyT key) const {
             return hotPages.isPresent(key) || candidatePages.isPresent(key);
         }
 
+        const Stats& stats() const { return stats_; }
+
+        size_type capacity() const { return cap; }
+        size_type candidate_capacity() const { return candidatePages.capacity(); }
+        bool adaptive_split() const { return adaptive; }
+
+        // Moves the candidate/hot boundary, clamped as in the constructor; the
+        // list that shrinks drops its LRU keys.
+        void resize_candidates(size_type candidates) {
+            candidates = std::min(candidates, cap);
+            if (adaptive)
+                candidates = std::clamp<size_type>(candidates, 1, cap - 1);
+            candidatePages.resize(candidates);
+            hotPages.resize(cap - candidates);
+        }
+
+        // Calls f(key) for every key of one list (cache_queue::candidate or
+        // cache_queue::hot), from its LRU key to its MRU key.
+        template <typename F>
+        void for_each_by_age(cache_queue q, F f) const { pagesOf(q).for_each_by_age(f); }
+        size_type queue_size(cache_queue q) const { return pagesOf(q).size(); }
+
+        // Makes key the MRU key of one list, dropping its LRU key if the list
+        // is full. Nothing is counted: this rebuilds a saved state, see
+        // snapshot.hpp.
+        void warm(cache_queue q, KeyT key) { (q == cache_queue::candidate ? candidatePages : hotPages).lookup_update(key); }
+
+        void clear() {
+            candidatePages.clear();
+            hotPages.clear();
+            candidateGhosts.clear();
+            hotGhosts.clear();
+        }
+
     private:
-        bool tryFindFreeSlots(KeyT key);
+        bool tryFindFreeSlots(KeyT key, hash_type h);
+
+        void adapt(bool growCandidates);
+
+        const lru_cache<KeyT, Hash>& pagesOf(cache_queue q) const { return q == cache_queue::candidate ? candidatePages : hotPages; }
+        lru_cache<KeyT, Hash>& ghostsOf(cache_queue q) { return q == cache_queue::candidate ? candidateGhosts : hotGhosts; }
+
+        // Drops the LRU key of pages; in adaptive mode it is remembered as a
+        // ghost unless it is still cached in the other list.
+        void evict(lru_cache<KeyT, Hash>& pages, cache_queue q) {
+            stats_.eviction(q);
+            if (!adaptive)
+                return;
+            const KeyT& victim = pages.lru_key();
+            if (!(q == cache_queue::candidate ? hotPages : candidatePages).isPresent(victim))
+                ghostsOf(q).lookup_update(victim);
+        }
+
+        // inserting an absent key into a full, non-empty list evicts its LRU key
+        void insert(lru_cache<KeyT, Hash>& pages, cache_queue q, KeyT key, hash_type h) {
+            if (pages.full() && pages.capacity() > 0)
+                evict(pages, q);
+            pages.lookup_update(key, h);
+        }
 
     private:
         size_type cap;
+        bool adaptive;
         lru_cache<KeyT, Hash> candidatePages;
         lru_cache<KeyT, Hash> hotPages;
+        // keys recently evicted from each list, only kept in adaptive mode
+        lru_cache<KeyT, Hash> candidateGhosts;
+        lru_cache<KeyT, Hash> hotGhosts;
+        [[no_unique_address]] Stats stats_;
     };
 
-    template <typename KeyT, typename Hash>
-    bool lru_2_cache<KeyT, Hash>::lookup_update(KeyT key) {
-        if (hotPages.isPresent(key)) {
-            hotPages.lookup_update(key);
+    template <typename KeyT, typename Hash, typename Stats>
+    bool lru_2_cache<KeyT, Hash, Stats>::lookup_update(KeyT key, hash_type h) {
+        [[maybe_unused]] auto scope = stats_.lookup();
+
+        if (hotPages.isPresent(key, h)) {
+            hotPages.lookup_update(key, h);
+            stats_.hit(cache_queue::hot);
             return true;
         }
 
-        if (candidatePages.isPresent(key)) {
-            candidatePages.remove(key);
-            hotPages.lookup_update(key);
+        // promoted keys keep their candidate slot until it ages out: lru_cache::remove
+        // used to be a no-op for present keys and the reference hit counts rely on it
+        if (candidatePages.isPresent(key, h)) {
+            insert(hotPages, cache_queue::hot, key, h);
+            stats_.hit(cache_queue::candidate);
+            stats_.promotion();
             return true;
         }
-        
-        if (tryFindFreeSlots(key))
+
+        if (adaptive) {
+            if (candidateGhosts.isPresent(key, h)) {
+                candidateGhosts.remove(key);
+                stats_.hit(cache_queue::ghost);
+                adapt(true);
+            } else if (hotGhosts.isPresent(key, h)) {
+                hotGhosts.remove(key);
+                stats_.hit(cache_queue::ghost);
+                adapt(false);
+            }
+        }
+
+        if (tryFindFreeSlots(key, h))
             return false;
 
         if (candidatePages.full()) {
-            candidatePages.lookup_update(key);
+            insert(candidatePages, cache_queue::candidate, key, h);
             return false;
         }
 
-        hotPages.lookup_update(key);
+        insert(hotPages, cache_queue::hot, key, h);
 
         return false;
     }
 
-    template <typename KeyT, typename Hash>
-    bool lru_2_cache<KeyT, Hash>::tryFindFreeSlots(KeyT key) {
+    template <typename KeyT, typename Hash, typename Stats>
+    bool lru_2_cache<KeyT, Hash, Stats>::tryFindFreeSlots(KeyT key, hash_type h) {
         if (full())
             return false;
 
         if (!candidatePages.full()) {
-            candidatePages.lookup_update(key);
+            candidatePages.lookup_update(key, h);
+            stats_.admission(cache_queue::candidate);
             return true;
         }
 
-        hotPages.lookup_update(key);
+        hotPages.lookup_update(key, h);
+        stats_.admission(cache_queue::hot);
         return true;
     }
-}
\ No newline at end of file
+
+    // A ghost hit in one list means that list was too small: it grows at the
+    // expense of the other one. As in ARC, the step is the size ratio of the
+    // opposite ghost list to this one, so the rarer signal moves the split
+    // faster. Both lists keep at least one slot.
+    template <typename KeyT, typename Hash, typename Stats>
+    void lru_2_cache<KeyT, Hash, Stats>::adapt(bool growCandidates) {
+        auto& grown = growCandidates ? candidateGhosts : hotGhosts;
+        auto& other = growCandidates ? hotGhosts : candidateGhosts;
+        size_type delta = std::max<size_type>(other.size() / std::max<size_type>(grown.size(), 1), 1);
+
+        size_type candidates = candidatePages.capacity();
+        candidates = growCandidates ? std::min(candidates + delta, cap - 1)
+                                    : candidates - std::min(delta, candidates - 1);
+        if (candidates == candidatePages.capacity())
+            return;
+
+        auto& shrunk = growCandidates ? hotPages : candidatePages;
+        auto q = growCandidates ? cache_queue::hot : cache_queue::candidate;
+        size_type target = growCandidates ? cap - candidates : candidates;
+        while (shrunk.size() > target) {
+            evict(shrunk, q);
+            shrunk.remove(KeyT{shrunk.lru_key()});
+        }
+        candidatePages.resize(candidates);
+        hotPages.resize(cap - candidates);
+    }
+
+    // lru_2_cache with the adaptive split, constructible from a capacity alone
+    // like the other policies (for the drivers and the simulations)
+    template<typename KeyT = int, typename Hash = std::hash<KeyT>, typename Stats = no_stats>
+    class adaptive_lru_2_cache : public lru_2_cache<KeyT, Hash, Stats> {
+    public:
+        using size_type = size_t;
+    public:
+        adaptive_lru_2_cache(size_type capacity, Stats stats = Stats{}) :
+            lru_2_cache<KeyT, Hash, Stats>(capacity, capacity / 2, split_policy::adaptive, std::move(stats)) {}
+    };
+}
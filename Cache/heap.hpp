@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace caches {
+    // Binary heap over slab slots. Each slot remembers its priority and its
+    // position in the heap, so changing the priority of a resident key is a
+    // single sift instead of a search. Like std::priority_queue, the default
+    // comparator puts the largest priority on top.
+    template <typename PriorityT, typename Compare = std::less<PriorityT>>
+    class indexed_heap {
+    public:
+        using size_type = size_t;
+        using index_type = std::uint32_t;
+
+        static constexpr index_type npos = std::numeric_limits<index_type>::max();
+
+    public:
+        indexed_heap(size_type capacity = 0) { reserve(capacity); }
+
+        void reserve(size_type capacity) {
+            heap_.reserve(capacity);
+            if (prio_.size() < capacity) {
+                prio_.resize(capacity);
+                pos_.resize(capacity, npos);
+            }
+        }
+
+        size_type size() const { return heap_.size(); }
+        bool empty() const { return heap_.empty(); }
+
+        bool contains(index_type slot) const { return slot < pos_.size() && pos_[slot] != npos; }
+
+        index_type top() const { return heap_.front(); }
+        const PriorityT& priority(index_type slot) const { return prio_[slot]; }
+
+        void push(index_type slot, const PriorityT& prio) {
+            if (slot >= pos_.size())
+                reserve(slot + 1);
+            prio_[slot] = prio;
+            pos_[slot] = static_cast<index_type>(heap_.size());
+            heap_.push_back(slot);
+            sift_up(pos_[slot]);
+        }
+
+        void update(index_type slot, const PriorityT& prio) {
+            bool up = cmp_(prio_[slot], prio);
+            prio_[slot] = prio;
+            if (up)
+                sift_up(pos_[slot]);
+            else
+                sift_down(pos_[slot]);
+        }
+
+        index_type pop() {
+            index_type slot = heap_.front();
+            erase(slot);
+            return slot;
+        }
+
+        void erase(index_type slot) {
+            size_type i = pos_[slot];
+            pos_[slot] = npos;
+            index_type last = heap_.back();
+            heap_.pop_back();
+            if (last == slot)
+                return;
+
+            heap_[i] = last;
+            pos_[last] = static_cast<index_type>(i);
+            sift_up(i);
+            sift_down(pos_[last]);
+        }
+
+        void clear() {
+            for (index_type slot : heap_)
+                pos_[slot] = npos;
+            heap_.clear();
+        }
+
+    private:
+        void place(size_type i, index_type slot) {
+            heap_[i] = slot;
+            pos_[slot] = static_cast<index_type>(i);
+        }
+
+        void sift_up(size_type i) {
+            index_type slot = heap_[i];
+            while (i > 0) {
+                size_type parent = (i - 1) / 2;
+                if (!cmp_(prio_[heap_[parent]], prio_[slot]))
+                    break;
+                place(i, heap_[parent]);
+                i = parent;
+            }
+            place(i, slot);
+        }
+
+        void sift_down(size_type i) {
+            index_type slot = heap_[i];
+            size_type n = heap_.size();
+            for (;;) {
+                size_type child = 2 * i + 1;
+                if (child >= n)
+                    break;
+                if (child + 1 < n && cmp_(prio_[heap_[child]], prio_[heap_[child + 1]]))
+                    child++;
+                if (!cmp_(prio_[slot], prio_[heap_[child]]))
+                    break;
+                place(i, heap_[child]);
+                i = child;
+            }
+            place(i, slot);
+        }
+
+    private:
+        std::vector<index_type> heap_;
+        std::vector<PriorityT> prio_;
+        std::vector<index_type> pos_;
+        [[no_unique_address]] Compare cmp_;
+    };
+}
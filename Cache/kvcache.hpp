@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "basic_cache.hpp"
+#include "slab.hpp"
+
+// Caches that keep the values themselves. The value lives in the slab node
+// next to the key and the policy links, so a hit is one index probe and one
+// node, with no second map to keep in sync.
+namespace caches {
+    template <typename Links, typename ValueT>
+    struct kv_node : Links {
+        std::optional<ValueT> value;
+        bool dirty = false;
+    };
+
+    template <typename KeyT, typename ValueT>
+    struct evicted_entry {
+        KeyT key;
+        ValueT value;
+        bool dirty;
+    };
+
+    // Single-threaded key-value cache over any basic_cache eviction policy.
+    // References returned by get_or_load, get and put stay valid until the
+    // next call that may evict. Evicted values are handed to the callback in
+    // batches of `evict_batch`; flush() delivers a partial batch. Values
+    // dropped by remove() or clear() bypass the callback.
+    template <typename KeyT, typename ValueT, typename EvictionPolicy = lru_policy, typename Hash = std::hash<KeyT>>
+    class kv_cache {
+    public:
+        using size_type = size_t;
+        using evicted = evicted_entry<KeyT, ValueT>;
+        using evict_callback = std::function<void(std::span<evicted>)>;
+        using hash_type = typename open_index<KeyT, Hash>::hash_type;
+
+    public:
+        explicit kv_cache(size_type capacity, evict_callback on_evict = {}, size_type evict_batch = 1,
+                          EvictionPolicy policy = EvictionPolicy{}) :
+            cap_{capacity}, storage_{capacity}, index_{capacity}, policy_{std::move(policy)},
+            on_evict_{std::move(on_evict)}, batch_{std::max<size_type>(evict_batch, 1)} {
+            if (capacity == 0)
+                throw std::invalid_argument("kv_cache needs room for at least one value");
+            if constexpr (requires { policy_.reserve(capacity); })
+                policy_.reserve(capacity);
+            if (on_evict_)
+                pending_.reserve(batch_);
+        }
+
+        size_type size() const { return storage_.size(); }
+        size_type capacity() const { return cap_; }
+        bool empty() const { return size() == 0; }
+        bool full() const { return size() == cap_; }
+
+        bool isPresent(const KeyT& key) const { return find(key, index_.hash(key)) != npos; }
+
+        // The cached value, or loader(key) cached first. If the loader throws
+        // nothing is cached or evicted.
+        template <typename Loader>
+        ValueT& get_or_load(const KeyT& key, Loader&& loader) {
+            hash_type h = index_.hash(key);
+            if (auto i = find(key, h); i != npos) {
+                policy_.accessed(storage_, i);
+                return *storage_.data(i).value;
+            }
+            return insert(key, h, std::forward<Loader>(loader)(key), false);
+        }
+
+        // the cached value or nullptr; a hit counts as an access
+        ValueT* get(const KeyT& key) {
+            auto i = find(key, index_.hash(key));
+            if (i == npos)
+                return nullptr;
+            policy_.accessed(storage_, i);
+            return &*storage_.data(i).value;
+        }
+
+        // Caches a new value and marks it dirty, so the eviction callback
+        // sees that it has to be written back.
+        ValueT& put(const KeyT& key, ValueT value) {
+            hash_type h = index_.hash(key);
+            if (auto i = find(key, h); i != npos) {
+                policy_.accessed(storage_, i);
+                auto& n = storage_.data(i);
+                n.value = std::move(value);
+                n.dirty = true;
+                return *n.value;
+            }
+            return insert(key, h, std::move(value), true);
+        }
+
+        // marks a value changed in place through a returned reference
+        bool mark_dirty(const KeyT& key) {
+            auto i = find(key, index_.hash(key));
+            if (i == npos)
+                return false;
+            storage_.data(i).dirty = true;
+            return true;
+        }
+
+        void remove(const KeyT& key) {
+            if (auto i = find(key, index_.hash(key)); i != npos)
+                erase(i);
+        }
+
+        // delivers the evictions buffered for an incomplete batch
+        void flush() {
+            if (pending_.empty())
+                return;
+            // the callback may throw; the batch is consumed either way
+            std::vector<evicted> batch;
+            batch.swap(pending_);
+            pending_.reserve(batch_);
+            on_evict_(std::span<evicted>(batch));
+        }
+
+        size_type pending_evictions() const { return pending_.size(); }
+
+        void clear() {
+            for (size_type i = 0; i < storage_.slab_size(); i++)
+                storage_.data(static_cast<index_type>(i)).value.reset();
+            storage_.clear();
+            index_.clear();
+            policy_.clear();
+        }
+
+    private:
+        using node = kv_node<typename EvictionPolicy::node_data, ValueT>;
+        using storage_type = slab_storage<KeyT, node>;
+        using index_type = typename storage_type::index_type;
+
+        static constexpr index_type npos = storage_type::npos;
+
+        index_type find(const KeyT& key, hash_type h) const {
+            return index_.find(key, h, [this](index_type i) -> const KeyT& { return storage_.key(i); });
+        }
+
+        ValueT& insert(const KeyT& key, hash_type h, ValueT value, bool dirty) {
+            if (full())
+                evict();
+            index_type i = storage_.allocate(key, static_cast<std::uint32_t>(h));
+            index_.insert(h, i);
+            policy_.inserted(storage_, i);
+            auto& n = storage_.data(i);
+            n.value.emplace(std::move(value));
+            n.dirty = dirty;
+            return *n.value;
+        }
+
+        void erase(index_type i) {
+            policy_.erased(storage_, i);
+            index_.erase(storage_.tag(i), i);
+            // released nodes keep their payload until reused, so drop the value now
+            storage_.data(i).value.reset();
+            storage_.release(i);
+        }
+
+        void evict() {
+            index_type i = policy_.victim(storage_);
+            if (on_evict_) {
+                auto& n = storage_.data(i);
+                pending_.push_back(evicted{storage_.key(i), std::move(*n.value), n.dirty});
+            }
+            erase(i);
+            if (pending_.size() >= batch_)
+                flush();
+        }
+
+    private:
+        size_type cap_;
+        storage_type storage_;
+        open_index<KeyT, Hash> index_;
+        EvictionPolicy policy_;
+        evict_callback on_evict_;
+        size_type batch_;
+        std::vector<evicted> pending_;
+    };
+
+    // Thread-safe key-value cache: kv_cache shards behind their own mutexes,
+    // holding shared_ptr<const ValueT> so a value handed out stays alive after
+    // it is evicted. Concurrent misses on one key are coalesced: the first
+    // caller runs the loader outside the lock and the others wait for its
+    // result (or its exception). Evictions are collected under the lock and
+    // passed to the callback after it is released, `evict_batch` at a time.
+    template <typename KeyT, typename ValueT, typename EvictionPolicy = lru_policy, typename Hash = std::hash<KeyT>>
+    class concurrent_kv_cache {
+    public:
+        using size_type = size_t;
+        using value_ptr = std::shared_ptr<const ValueT>;
+        using evicted = evicted_entry<KeyT, value_ptr>;
+        using evict_callback = std::function<void(std::span<evicted>)>;
+
+    public:
+        concurrent_kv_cache(size_type capacity, size_type shards = 16, evict_callback on_evict = {},
+                            size_type evict_batch = 1) :
+            count_{shards}, on_evict_{std::move(on_evict)}, batch_{std::max<size_type>(evict_batch, 1)} {
+            if (shards == 0 || capacity < shards)
+                throw std::invalid_argument("concurrent_kv_cache needs at least one shard and one value per shard");
+
+            shards_ = std::make_unique<shard[]>(shards);
+            for (size_type i = 0; i < shards; i++) {
+                typename shard::cache_type::evict_callback collect;
+                if (on_evict_)
+                    collect = [s = &shards_[i]](std::span<evicted> batch) {
+                        for (auto& e : batch)
+                            s->pending.push_back(std::move(e));
+                    };
+                shards_[i].cache.emplace(capacity / shards + (i < capacity % shards), std::move(collect));
+            }
+        }
+
+        template <typename Loader>
+        value_ptr get_or_load(const KeyT& key, Loader&& loader) {
+            shard& s = shard_of(key);
+            std::unique_lock lock{s.mutex};
+            if (auto* v = s.cache->get(key))
+                return *v;
+
+            // someone is already loading this key: wait for their result
+            if (auto it = s.loading.find(key); it != s.loading.end()) {
+                auto result = it->second;
+                lock.unlock();
+                return result.get();
+            }
+
+            std::promise<value_ptr> promise;
+            s.loading.emplace(key, promise.get_future().share());
+            lock.unlock();
+
+            value_ptr value;
+            try {
+                value = std::make_shared<const ValueT>(std::forward<Loader>(loader)(key));
+                loads_.fetch_add(1, std::memory_order_relaxed);
+            } catch (...) {
+                lock.lock();
+                s.loading.erase(key);
+                lock.unlock();
+                promise.set_exception(std::current_exception());
+                throw;
+            }
+
+            lock.lock();
+            std::vector<evicted> batch;
+            try {
+                // a put() while loading wins over the loaded value
+                value = s.cache->get_or_load(key, [&](const KeyT&) { return value; });
+                batch = take_batch(s);
+            } catch (...) {
+                // the insert or the eviction callback ran out of memory: the
+                // waiters get the error and the next caller loads again
+                s.loading.erase(key);
+                lock.unlock();
+                promise.set_exception(std::current_exception());
+                throw;
+            }
+            s.loading.erase(key);
+            lock.unlock();
+
+            promise.set_value(value);
+            deliver(batch);
+            return value;
+        }
+
+        value_ptr get(const KeyT& key) {
+            shard& s = shard_of(key);
+            std::lock_guard lock{s.mutex};
+            auto* v = s.cache->get(key);
+            return v ? *v : nullptr;
+        }
+
+        // caches the value as dirty, for the eviction callback to write back
+        void put(const KeyT& key, ValueT value) {
+            shard& s = shard_of(key);
+            std::unique_lock lock{s.mutex};
+            s.cache->put(key, std::make_shared<const ValueT>(std::move(value)));
+            auto batch = take_batch(s);
+            lock.unlock();
+            deliver(batch);
+        }
+
+        bool isPresent(const KeyT& key) const {
+            const shard& s = shard_of(key);
+            std::lock_guard lock{s.mutex};
+            return s.cache->isPresent(key);
+        }
+
+        // delivers every eviction still waiting for a full batch
+        void flush() {
+            for (size_type i = 0; i < count_; i++) {
+                std::vector<evicted> batch;
+                {
+                    std::lock_guard lock{shards_[i].mutex};
+                    batch.swap(shards_[i].pending);
+                }
+                deliver(batch);
+            }
+        }
+
+        // loader calls that completed, for telling coalesced misses apart
+        size_type loads() const { return loads_.load(std::memory_order_relaxed); }
+
+        size_type shard_count() const { return count_; }
+
+    private:
+        struct alignas(64) shard {
+            using cache_type = kv_cache<KeyT, value_ptr, EvictionPolicy, Hash>;
+
+            mutable std::mutex mutex;
+            std::optional<cache_type> cache;
+            std::unordered_map<KeyT, std::shared_future<value_ptr>, Hash> loading;
+            std::vector<evicted> pending;
+        };
+
+        // called under the shard lock
+        std::vector<evicted> take_batch(shard& s) {
+            std::vector<evicted> batch;
+            if (s.pending.size() >= batch_)
+                batch.swap(s.pending);
+            return batch;
+        }
+
+        void deliver(std::vector<evicted>& batch) {
+            if (!batch.empty())
+                on_evict_(std::span<evicted>(batch));
+        }
+
+        size_type index_of(const KeyT& key) const {
+            std::uint64_t h = mix_hash(static_cast<std::uint64_t>(hasher_(key)));
+            return static_cast<size_type>(((h >> 32) * count_) >> 32);
+        }
+
+        shard& shard_of(const KeyT& key) { return shards_[index_of(key)]; }
+        const shard& shard_of(const KeyT& key) const { return shards_[index_of(key)]; }
+
+    private:
+        size_type count_;
+        std::unique_ptr<shard[]> shards_;
+        evict_callback on_evict_;
+        size_type batch_;
+        std::atomic<size_type> loads_{0};
+        [[no_unique_address]] Hash hasher_;
+    };
+}
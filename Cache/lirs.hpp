@@ -0,0 +1,293 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+#include "batch.hpp"
+#include "slab.hpp"
+
+namespace caches {
+    // Low Inter-reference Recency Set (Jiang & Zhang, SIGMETRICS'02). Keys are
+    // ranked by the recency of their last two references instead of their
+    // last one. Most of the cache holds LIR keys, those with a short reuse
+    // distance; the rest (1%) holds resident HIR keys in a FIFO queue Q, and
+    // evictions only ever come from Q. The stack S orders LIR keys, resident
+    // HIR keys and non-resident HIR keys (metadata only) by recency, and is
+    // pruned so that its bottom is always a LIR key. A HIR key hit while
+    // still in S was reused sooner than the oldest LIR key: it becomes LIR
+    // and the bottom LIR key is demoted to Q. A loop longer than the cache
+    // thus keeps most of its keys as LIR instead of flushing them all as LRU
+    // does.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class lirs_cache {
+    public:
+        using size_type = size_t;
+        using hash_type = typename open_index<KeyT, Hash>::hash_type;
+
+    public:
+        // non-resident HIR keys are bounded by the capacity as well
+        lirs_cache(size_type capacity, double hir_fraction = 0.01) :
+            cap_{capacity},
+            hir_cap_{capacity == 0 ? 0 : std::clamp<size_type>(static_cast<size_type>(capacity * hir_fraction), 1, capacity)},
+            lir_cap_{capacity - hir_cap_}, nodes_{2 * capacity}, index_{2 * capacity} {}
+
+        size_type size() const { return lir_size_ + hir_size_; }
+        size_type capacity() const { return cap_; }
+        bool full() const { return size() == cap_; }
+
+        size_type lir_size() const { return lir_size_; }
+        size_type hir_size() const { return hir_size_; }
+        size_type nonresident_size() const { return nonresident_size_; }
+
+        bool lookup_update(const KeyT& key) { return lookup_update(key, hash(key)); }
+        // h must be hash(key)
+        bool lookup_update(const KeyT& key, hash_type h);
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return index_.hash(key); }
+        void prefetch(hash_type h) const { index_.prefetch(h); }
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            if (auto i = find(key, h); i != npos)
+                nodes_.prefetch(i);
+        }
+
+        bool isPresent(const KeyT& key) const {
+            auto i = find(key, hash(key));
+            return i != npos && nodes_.data(i).state != status::nonresident;
+        }
+        bool isLir(const KeyT& key) const {
+            auto i = find(key, hash(key));
+            return i != npos && nodes_.data(i).state == status::lir;
+        }
+
+        void clear() {
+            nodes_.clear();
+            index_.clear();
+            stack_.clear();
+            queue_.clear();
+            ghosts_.clear();
+            lir_size_ = hir_size_ = nonresident_size_ = 0;
+        }
+
+    private:
+        enum class status : std::uint8_t { lir, hir, nonresident };
+
+        // Every key is in S, in Q or both. Resident HIR keys use the queue
+        // links for Q; non-resident ones, which are never in Q, use them for
+        // the FIFO that bounds their number.
+        struct node {
+            list_links stack;
+            list_links queue;
+            status state;
+            bool in_stack;
+        };
+
+        using storage_type = slab_storage<KeyT, node>;
+        using index_type = typename storage_type::index_type;
+
+        static constexpr index_type npos = storage_type::npos;
+
+        // one link set of the nodes, as the storage intrusive_list expects
+        template <list_links node::*Links>
+        struct links_of {
+            storage_type& nodes;
+            list_links& data(index_type i) { return nodes.data(i).*Links; }
+        };
+
+        links_of<&node::stack> stack_links() { return {nodes_}; }
+        links_of<&node::queue> queue_links() { return {nodes_}; }
+
+        index_type find(const KeyT& key, hash_type h) const {
+            return index_.find(key, h, [this](index_type i) -> const KeyT& { return nodes_.key(i); });
+        }
+
+        void push_stack(index_type i) {
+            auto links = stack_links();
+            stack_.link_front(links, i);
+            nodes_.data(i).in_stack = true;
+        }
+
+        void to_stack_top(index_type i) {
+            auto links = stack_links();
+            stack_.move_to_front(links, i);
+        }
+
+        void unlink_stack(index_type i) {
+            auto links = stack_links();
+            stack_.unlink(links, i);
+            nodes_.data(i).in_stack = false;
+        }
+
+        void push_queue(intrusive_list& list, index_type i) {
+            auto links = queue_links();
+            list.link_front(links, i);
+        }
+
+        void unlink_queue(intrusive_list& list, index_type i) {
+            auto links = queue_links();
+            list.unlink(links, i);
+        }
+
+        void erase(index_type i) {
+            index_.erase(nodes_.tag(i), i);
+            nodes_.release(i);
+        }
+
+        void prune();
+        void demote_bottom();
+        void evict();
+
+    private:
+        size_type cap_;
+        size_type hir_cap_;
+        size_type lir_cap_;
+        storage_type nodes_;
+        open_index<KeyT, Hash> index_;
+        // top at the front
+        intrusive_list stack_;
+        // resident HIR keys, oldest (the next victim) at the back
+        intrusive_list queue_;
+        // non-resident HIR keys, oldest at the back
+        intrusive_list ghosts_;
+        size_type lir_size_ = 0;
+        size_type hir_size_ = 0;
+        size_type nonresident_size_ = 0;
+    };
+
+    template <typename KeyT, typename Hash>
+    bool lirs_cache<KeyT, Hash>::lookup_update(const KeyT& key, hash_type h) {
+        index_type i = find(key, h);
+        if (i != npos && nodes_.data(i).state == status::lir) {
+            bool bottom = i == stack_.back();
+            to_stack_top(i);
+            if (bottom)
+                prune();
+            return true;
+        }
+
+        if (i != npos && nodes_.data(i).state == status::hir) {
+            // reused within the recency of the oldest LIR key; with no LIR set
+            // at all (capacity 1) it stays HIR like a reused non-resident key
+            if (nodes_.data(i).in_stack && lir_cap_ > 0) {
+                unlink_queue(queue_, i);
+                hir_size_--;
+                nodes_.data(i).state = status::lir;
+                lir_size_++;
+                to_stack_top(i);
+                demote_bottom();
+            } else {
+                if (nodes_.data(i).in_stack)
+                    to_stack_top(i);
+                else
+                    push_stack(i);
+                unlink_queue(queue_, i);
+                push_queue(queue_, i);
+            }
+            return true;
+        }
+
+        if (cap_ == 0)
+            return false;
+
+        // taken out of the non-resident FIFO first, so that evicting cannot drop it
+        bool reused = i != npos;
+        if (reused) {
+            unlink_queue(ghosts_, i);
+            nonresident_size_--;
+        }
+        if (full())
+            evict();
+
+        if (!reused) {
+            i = nodes_.allocate(key, static_cast<std::uint32_t>(h));
+            index_.insert(h, i);
+            nodes_.data(i).in_stack = false;
+        }
+
+        if (lir_size_ < lir_cap_) {
+            // warm-up: the first keys fill the LIR set
+            nodes_.data(i).state = status::lir;
+            lir_size_++;
+            if (reused)
+                to_stack_top(i);
+            else
+                push_stack(i);
+            return false;
+        }
+
+        // a non-resident key is still in S, so its reuse distance beats the
+        // oldest LIR key; with no LIR set at all (capacity 1) it stays HIR
+        if (reused && lir_cap_ > 0) {
+            nodes_.data(i).state = status::lir;
+            lir_size_++;
+            to_stack_top(i);
+            demote_bottom();
+            return false;
+        }
+
+        nodes_.data(i).state = status::hir;
+        hir_size_++;
+        if (reused)
+            to_stack_top(i);
+        else
+            push_stack(i);
+        push_queue(queue_, i);
+        return false;
+    }
+
+    // Drops HIR keys from the bottom of S until a LIR key is there. Resident
+    // ones stay in Q; non-resident ones are forgotten.
+    template <typename KeyT, typename Hash>
+    void lirs_cache<KeyT, Hash>::prune() {
+        for (index_type b = stack_.back(); b != npos && nodes_.data(b).state != status::lir; b = stack_.back()) {
+            unlink_stack(b);
+            if (nodes_.data(b).state == status::nonresident) {
+                unlink_queue(ghosts_, b);
+                nonresident_size_--;
+                erase(b);
+            }
+        }
+    }
+
+    // The LIR key at the bottom of S becomes a resident HIR key.
+    template <typename KeyT, typename Hash>
+    void lirs_cache<KeyT, Hash>::demote_bottom() {
+        index_type b = stack_.back();
+        unlink_stack(b);
+        nodes_.data(b).state = status::hir;
+        lir_size_--;
+        hir_size_++;
+        push_queue(queue_, b);
+        prune();
+    }
+
+    // Evicts the oldest resident HIR key; it stays in S as a non-resident
+    // key if it is there. The LIR set never takes more than lir_cap_ slots,
+    // so Q is not empty once the cache is full.
+    template <typename KeyT, typename Hash>
+    void lirs_cache<KeyT, Hash>::evict() {
+        index_type v = queue_.back();
+        unlink_queue(queue_, v);
+        hir_size_--;
+        if (!nodes_.data(v).in_stack) {
+            erase(v);
+            return;
+        }
+
+        nodes_.data(v).state = status::nonresident;
+        push_queue(ghosts_, v);
+        if (++nonresident_size_ > cap_) {
+            index_type g = ghosts_.back();
+            unlink_queue(ghosts_, g);
+            unlink_stack(g);
+            nonresident_size_--;
+            erase(g);
+        }
+    }
+}
@@ -1,35 +1,184 @@
+#include "arc.hpp"
+#include "basic_cache.hpp"
 #include "cache.hpp"
+#include "lirs.hpp"
 #include "lrucache.hpp"
 #include "perfectcache.hpp"
+#include "s3fifo.hpp"
+#include "sizedcache.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "tinylfu.hpp"
+#include "trace.hpp"
+#include "twoqueue.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <sstream>
 
 using namespace caches;
 
-int main() {
-    int hits = 0;
-    int n;
-    size_t m;
+template <typename Cache>
+int run(Cache& cache, const caches::trace& requests) {
+    std::uint64_t hits = 0;
+    for (auto q : requests)
+        hits += cache.lookup_update(caches::int_key(q));
 
-    std::cin >> m >> n;
-    if (!std::cin.good()) {
-        std::cerr << "failed to read input\n";
-        return 1;
+    std::cout << hits << '\n';
+    return 0;
+}
+
+// byte-capacity caches get the size of every request; a sized trace also
+// reports the bytes served from the cache
+template <typename Cache>
+int run_sized(Cache& cache, const caches::trace& requests) {
+    std::uint64_t hits = 0, bytes = 0;
+    for (auto it = requests.begin(); it != requests.end(); ++it) {
+        if (cache.lookup_update_sized(caches::int_key(*it), it.object_size())) {
+            hits++;
+            bytes += it.object_size();
+        }
     }
 
-    caches::lru_2_cache lru2(m);
+    std::cout << hits;
+    if (requests.sized())
+        std::cout << ' ' << bytes;
+    std::cout << '\n';
+    return 0;
+}
 
-    for (int i = 0; i < n; i++) {
-        int q;
-        std::cin >> q;
-        if (!std::cin.good()) {
-            std::cerr << "failed to read input\n";
+// warm-starts lru2 from the snapshot if it exists, and saves the final state to it
+template <typename Cache>
+int run_with_snapshot(Cache& cache, const caches::trace& requests, const std::string& path) {
+    if (std::filesystem::exists(path))
+        caches::restore_snapshot(cache, path);
+    int status = run(cache, requests);
+    caches::save_snapshot(cache, path);
+    return status;
+}
+
+template <typename Cache>
+int run_with_stats(Cache& cache, const caches::trace& requests) {
+    int status = run(cache, requests);
+    cache.stats().write_json(std::cerr);
+    return status;
+}
+
+// usage: cache [--stats[=N]] [--snapshot=PATH] [policy] [trace file]; without
+// a file the text trace is read from stdin, a file may be text or binary (see
+// trace_convert). --stats writes per-queue counters of lru2 and 2q as JSON to
+// stderr, with a time series sample every N lookups. --snapshot starts lru2
+// and lru2-adaptive from the state saved in PATH, if any, and saves the state
+// they end in there; either option is an error with any other policy.
+// gdsf and lru-bytes measure m in bytes and, on a sized trace, print the
+// bytes hit after the hits.
+int main(int argc, char** argv) try {
+    int arg = 1;
+    bool stats = false;
+    std::uint64_t interval = 0;
+    std::string snapshot;
+    for (; arg < argc && std::string_view(argv[arg]).starts_with("--"); arg++) {
+        std::string_view opt = argv[arg];
+        if (opt == "--stats" || opt.starts_with("--stats=")) {
+            stats = true;
+            if (opt.size() > 8)
+                interval = std::stoull(std::string(opt.substr(8)));
+        } else if (opt.starts_with("--snapshot=")) {
+            snapshot = std::string(opt.substr(11));
+        } else {
+            std::cerr << "unknown option " << opt << '\n';
             return 1;
         }
-        hits += lru2.lookup_update(q);
     }
 
-    std::cout << hits << '\n';
-}
\ No newline at end of file
+    std::string policy = arg < argc ? argv[arg] : "lru2";
+    // the other policies have no per-queue counters or snapshots
+    if (stats && policy != "lru2" && policy != "2q") {
+        std::cerr << "--stats is only supported by lru2 and 2q\n";
+        return 1;
+    }
+    if (!snapshot.empty() && (stats || (policy != "lru2" && policy != "lru2-adaptive"))) {
+        std::cerr << "--snapshot is only supported by lru2 and lru2-adaptive, without --stats\n";
+        return 1;
+    }
+    auto requests = arg + 1 < argc ? caches::trace::open(argv[arg + 1]) : caches::trace::parse(std::cin);
+    size_t m = requests.capacity();
+    // time one lookup in 1024
+    caches::counting_stats counters(interval, 1024);
+
+    if (policy == "lru2") {
+        if (stats) {
+            caches::lru_2_cache<int, std::hash<int>, caches::counting_stats> lru2(m, counters);
+            return run_with_stats(lru2, requests);
+        }
+        caches::lru_2_cache lru2(m);
+        return snapshot.empty() ? run(lru2, requests) : run_with_snapshot(lru2, requests, snapshot);
+    }
+    if (policy == "lru2-adaptive") {
+        caches::adaptive_lru_2_cache lru2(m);
+        return snapshot.empty() ? run(lru2, requests) : run_with_snapshot(lru2, requests, snapshot);
+    }
+    if (policy == "2q") {
+        if (stats) {
+            caches::two_q_cache<int, std::hash<int>, caches::counting_stats> twoq(m, 0.25, 0.5, counters);
+            return run_with_stats(twoq, requests);
+        }
+        caches::two_q_cache twoq(m);
+        return run(twoq, requests);
+    }
+    if (policy == "lru") {
+        caches::lru_cache lru(m);
+        return run(lru, requests);
+    }
+    if (policy == "fifo") {
+        caches::fifo_cache fifo(m);
+        return run(fifo, requests);
+    }
+    if (policy == "slru") {
+        caches::slru_cache slru(m);
+        return run(slru, requests);
+    }
+    if (policy == "lru-dense") {
+        // the keys of the trace are the universe, so they must not be negative
+        std::int64_t maxKey = -1;
+        for (auto q : requests)
+            maxKey = std::max(maxKey, q);
+        caches::dense_cache lru(m, caches::key_universe{static_cast<size_t>(maxKey + 1)});
+        return run(lru, requests);
+    }
+    if (policy == "arc") {
+        caches::arc_cache arc(m);
+        return run(arc, requests);
+    }
+    if (policy == "s3fifo") {
+        caches::s3fifo_cache s3fifo(m);
+        return run(s3fifo, requests);
+    }
+    if (policy == "lirs") {
+        caches::lirs_cache lirs(m);
+        return run(lirs, requests);
+    }
+    if (policy == "tinylfu") {
+        caches::tinylfu_cache tinylfu(m);
+        return run(tinylfu, requests);
+    }
+
+    if (policy == "gdsf") {
+        caches::gdsf_cache gdsf(m);
+        return run_sized(gdsf, requests);
+    }
+    if (policy == "lru-bytes") {
+        caches::sized_lru_cache lru(m);
+        return run_sized(lru, requests);
+    }
+
+    std::cerr << "unknown policy " << policy << ", expected one of: lru2 lru2-adaptive 2q lru fifo slru lru-dense arc s3fifo lirs tinylfu gdsf lru-bytes\n";
+    return 1;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
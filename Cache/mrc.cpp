@@ -0,0 +1,134 @@
+#include "arc.hpp"
+#include "cache.hpp"
+#include "lrucache.hpp"
+#include "mrc.hpp"
+#include "shards.hpp"
+#include "tinylfu.hpp"
+#include "trace.hpp"
+#include "twoqueue.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace caches;
+
+namespace {
+    struct options {
+        std::string policy = "lru";
+        double rate = 0.0;
+        size_t size = 0;
+        size_t points = 20;
+        std::string file;
+    };
+
+    bool parse(int argc, char** argv, options& opts) {
+        int i = 1;
+        for (; i + 1 < argc; i += 2) {
+            std::string flag = argv[i];
+            if (flag == "--policy")
+                opts.policy = argv[i + 1];
+            else if (flag == "--rate")
+                opts.rate = std::atof(argv[i + 1]);
+            else if (flag == "--size")
+                opts.size = std::strtoull(argv[i + 1], nullptr, 10);
+            else if (flag == "--points")
+                opts.points = std::strtoull(argv[i + 1], nullptr, 10);
+            else
+                break;
+        }
+        if (i < argc)
+            opts.file = argv[i++];
+        return i == argc && opts.points > 0;
+    }
+
+    template <typename Analyzer>
+    void replay(Analyzer& analyzer, const trace& requests) {
+        for (auto q : requests)
+            analyzer.access(int_key(q));
+    }
+
+    void print(const std::vector<mrc_point>& curve) {
+        std::cout << "# capacity miss_ratio error\n";
+        for (const auto& p : curve)
+            std::cout << p.capacity << ' ' << p.miss_ratio << ' ' << p.error << '\n';
+    }
+
+    template <typename Cache>
+    int simulate(const options& opts, const std::vector<size_t>& capacities, const trace& requests) {
+        shards_sim<Cache> sim(opts.rate, capacities);
+        replay(sim, requests);
+        std::cout << "# rate " << sim.rate() << " sampled " << sim.sampled() << '\n';
+        print(sim.curve());
+        return 0;
+    }
+}
+
+// Without flags prints the exact LRU hit-ratio curve of the trace for every
+// capacity in one pass; only capacities where the hit count changes are
+// listed. With --rate or --size the curve is estimated by SHARDS sampling at
+// --points capacities up to the m of the trace header. Without a file the
+// text trace is read from stdin, a file may be text or binary (see
+// trace_convert); binary traces are streamed from the mapping.
+int main(int argc, char** argv) try {
+    options opts;
+    if (!parse(argc, argv, opts)) {
+        std::cerr << "usage: mrc [--rate R | --size S] [--policy lru|lru2|lru2-adaptive|2q|arc|tinylfu] [--points K] [trace file]\n";
+        return 1;
+    }
+
+    auto requests = opts.file.empty() ? trace::parse(std::cin) : trace::open(opts.file);
+    size_t m = requests.capacity();
+
+    if (opts.rate == 0.0 && opts.size == 0) {
+        if (opts.policy != "lru") {
+            std::cerr << "only the lru curve is exact, use --rate for " << opts.policy << '\n';
+            return 1;
+        }
+
+        caches::stack_distance_analyzer analyzer;
+        replay(analyzer, requests);
+
+        std::cout << "# requests " << analyzer.requests() << " distinct " << analyzer.distinct() << '\n';
+        std::cout << "# capacity hits hit_ratio\n";
+        for (auto [capacity, hits] : analyzer.hit_curve())
+            std::cout << capacity << ' ' << hits << ' ' << static_cast<double>(hits) / analyzer.requests() << '\n';
+        return 0;
+    }
+
+    std::vector<size_t> capacities;
+    for (size_t i = 1; i <= opts.points; i++)
+        capacities.push_back(std::max<size_t>(1, m * i / opts.points));
+
+    if (opts.policy == "lru") {
+        auto shards = opts.size ? shards_lru<int>::fixed_size(opts.size, opts.rate ? opts.rate : 0.1)
+                                : shards_lru<int>::fixed_rate(opts.rate);
+        replay(shards, requests);
+        std::cout << "# rate " << shards.rate() << " sampled keys " << shards.sampled_keys() << '\n';
+        print(shards.curve(capacities));
+        return 0;
+    }
+
+    // miniature simulations only come in the fixed-rate flavour
+    if (opts.rate == 0.0) {
+        std::cerr << "--policy " << opts.policy << " needs --rate\n";
+        return 1;
+    }
+    if (opts.policy == "lru2")
+        return simulate<lru_2_cache<int>>(opts, capacities, requests);
+    if (opts.policy == "lru2-adaptive")
+        return simulate<adaptive_lru_2_cache<int>>(opts, capacities, requests);
+    if (opts.policy == "2q")
+        return simulate<two_q_cache<int>>(opts, capacities, requests);
+    if (opts.policy == "arc")
+        return simulate<arc_cache<int>>(opts, capacities, requests);
+    if (opts.policy == "tinylfu")
+        return simulate<tinylfu_cache<int>>(opts, capacities, requests);
+
+    std::cerr << "unknown policy " << opts.policy << ", expected one of: lru lru2 lru2-adaptive 2q arc tinylfu\n";
+    return 1;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace caches {
+    // Prefix sums over [0, size) with O(log size) point updates.
+    class fenwick_tree {
+    public:
+        using size_type = size_t;
+    public:
+        fenwick_tree(size_type size = 0) : tree_(size + 1, 0) {}
+
+        size_type size() const { return tree_.size() - 1; }
+
+        void add(size_type i, long delta) {
+            for (++i; i < tree_.size(); i += i & (~i + 1))
+                tree_[i] += delta;
+        }
+
+        // sum over [0, i)
+        long prefix(size_type i) const {
+            long sum = 0;
+            for (; i > 0; i -= i & (~i + 1))
+                sum += tree_[i];
+            return sum;
+        }
+
+    private:
+        std::vector<long> tree_;
+    };
+
+    // Mattson's LRU stack distances in one pass. The Fenwick tree is indexed by
+    // access time and holds a mark at the last access of every key, so the
+    // distance of a re-reference is the number of marks after its previous
+    // access. Times are renumbered when the tree fills up, which keeps memory
+    // proportional to the number of distinct keys rather than the trace length.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class stack_distance_analyzer {
+    public:
+        using size_type = size_t;
+
+        static constexpr size_type cold = 0;
+
+    public:
+        stack_distance_analyzer(size_type initial_size = 1 << 16) : times_{std::max<size_type>(initial_size, 2)} {}
+
+        // Returns the stack distance of this access (1 for the most recently used
+        // key) or `cold` for the first reference. An LRU cache of capacity c hits
+        // exactly the accesses with distance in [1, c].
+        size_type access(const KeyT& key) {
+            if (now_ == times_.size())
+                compact();
+
+            requests_++;
+            auto [it, inserted] = last_.try_emplace(key, now_);
+            size_type distance = cold;
+            if (inserted) {
+                cold_++;
+            } else {
+                distance = static_cast<size_type>(live_ - times_.prefix(it->second + 1)) + 1;
+                times_.add(it->second, -1);
+                live_--;
+                it->second = now_;
+                if (histogram_.size() <= distance)
+                    histogram_.resize(distance + 1, 0);
+                histogram_[distance]++;
+            }
+            times_.add(now_++, 1);
+            live_++;
+            return distance;
+        }
+
+        // Drops every trace of key, as if it had never been referenced. Sampling
+        // analyzers use this to stay within a fixed number of tracked keys.
+        void forget(const KeyT& key) {
+            auto it = last_.find(key);
+            if (it == last_.end())
+                return;
+            times_.add(it->second, -1);
+            live_--;
+            last_.erase(it);
+        }
+
+        size_type requests() const { return requests_; }
+        size_type cold_misses() const { return cold_; }
+        size_type distinct() const { return last_.size(); }
+
+        // histogram()[d] is the number of accesses with stack distance d
+        const std::vector<size_type>& histogram() const { return histogram_; }
+
+        // hits of an LRU cache with the given capacity
+        size_type hits(size_type capacity) const {
+            size_type total = 0;
+            for (size_type d = 1; d < histogram_.size() && d <= capacity; d++)
+                total += histogram_[d];
+            return total;
+        }
+
+        // (capacity, hits) at every capacity where the hit count grows; between
+        // two points the curve is flat, so this is the whole curve
+        std::vector<std::pair<size_type, size_type>> hit_curve() const {
+            std::vector<std::pair<size_type, size_type>> curve;
+            size_type total = 0;
+            for (size_type d = 1; d < histogram_.size(); d++) {
+                if (histogram_[d] == 0)
+                    continue;
+                total += histogram_[d];
+                curve.emplace_back(d, total);
+            }
+            return curve;
+        }
+
+    private:
+        void compact() {
+            std::vector<std::pair<size_type, KeyT>> order;
+            order.reserve(last_.size());
+            for (const auto& [key, time] : last_)
+                order.emplace_back(time, key);
+            std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            times_ = fenwick_tree{std::max(2 * order.size(), times_.size())};
+            for (size_type i = 0; i < order.size(); i++) {
+                last_[order[i].second] = i;
+                times_.add(i, 1);
+            }
+            now_ = order.size();
+        }
+
+    private:
+        fenwick_tree times_;
+        std::unordered_map<KeyT, size_type, Hash> last_;
+        std::vector<size_type> histogram_;
+        size_type now_ = 0;
+        long live_ = 0;
+        size_type requests_ = 0;
+        size_type cold_ = 0;
+    };
+}
@@ -1,36 +1,48 @@
 #include "cache.hpp"
 #include "lrucache.hpp"
 #include "perfectcache.hpp"
+#include "trace.hpp"
 
+#include <cstdint>
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 using namespace caches;
 
-int main() {
-    int hits = 0;
-    int n;
-    size_t m;
+// usage: perfectcache [trace file]; without a file the text trace is read from
+// stdin, a file may be text or binary (see trace_convert). A sized trace is
+// replayed with m in bytes through sized_perfect_cache, and the bytes hit are
+// printed after the hits.
+int main(int argc, char** argv) try {
+    std::uint64_t hits = 0;
+    auto input = argc > 1 ? caches::trace::open(argv[1]) : caches::trace::parse(std::cin);
 
-    std::cin >> m >> n;
-    if (!std::cin.good()) {
-        std::cerr << "failed to read input\n";
-        return 1;
-    }
-    
-    std::vector<int> input(n);
-    for (int i = 0; i < n; i++) {
-        std::cin >> input[i];
-        if (!std::cin.good()) {
-            std::cerr << "failed to read input\n";
-            return 1;
+    if (input.sized()) {
+        std::uint64_t bytes = 0;
+        caches::sized_perfect_cache perf(input.capacity(), input.begin(), input.end());
+        for (auto it = input.begin(); it != input.end(); ++it) {
+            if (perf.lookup_update_sized(caches::int_key(*it), it.object_size())) {
+                hits++;
+                bytes += it.object_size();
+            }
         }
+        std::cout << hits << ' ' << bytes << '\n';
+        return 0;
     }
 
-    caches::perfect_cache perf(m, input.begin(), input.end());
-    for (int i = 0; i < n; i++) {
-        hits += perf.lookup_update(input[i]);
+    // decoded once, so that the oracle can be built on every core
+    std::vector<int> keys;
+    keys.reserve(input.size());
+    for (auto q : input)
+        keys.push_back(caches::int_key(q));
+    caches::perfect_cache perf(input.capacity(), caches::compute_next_use_parallel<std::uint32_t, int>(keys));
+    for (int key : keys) {
+        hits += perf.lookup_update(key);
     }
     std::cout << hits << '\n';
-}
\ No newline at end of file
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
@@ -1,96 +1,370 @@
 #pragma once
 
 #include <vector>
-#include <list>
-#include <unordered_map>
-#include <deque>
+#include <utility>
 #include <iostream>
+#include <iterator>
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <thread>
+
+#include "basic_cache.hpp"
+#include "heap.hpp"
+#include "sizedcache.hpp"
+#include "slab.hpp"
 
 namespace caches {
-    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
-    class perfect_cache {
+    // Key -> position map of the next-use passes: linear probing over a flat
+    // array that doubles at half load. The maximum of PosT, which is never a
+    // position, marks an empty slot.
+    template <typename KeyT, typename PosT, typename Hash>
+    class position_map {
     public:
-        using size_type = size_t;
-    
+        static constexpr PosT empty = std::numeric_limits<PosT>::max();
+
     public:
-        template <typename It>
-        perfect_cache(size_type size, It begin, It end) : size_{size} {
-            size_type i = 0;
-            while (begin != end) {
-                auto find = mp_.find(*begin);
-                if (find == mp_.end())
-                    mp_.insert({*begin, std::deque<size_type>{i}});
-                else
-                    find->second.push_back(i);
-                i++;
-                begin++;
-            }
+        position_map() { slots_.resize(16); }
+
+        // the position stored for key, inserting pos if there is none
+        std::pair<PosT&, bool> try_emplace(const KeyT& key, PosT pos) {
+            if (2 * (size_ + 1) > slots_.size())
+                grow();
+            size_t i = find_slot(key);
+            if (slots_[i].pos != empty)
+                return {slots_[i].pos, false};
+            slots_[i] = slot{key, pos};
+            size_++;
+            return {slots_[i].pos, true};
         }
 
-        bool full() const { return cache_.size() == size_; }
+        // the position stored for key, or empty
+        PosT find(const KeyT& key) const { return slots_[find_slot(key)].pos; }
 
-        bool lookup_update(const KeyT& key) {
-            auto find = hash_.find(key);
-            if (find == hash_.end()) {
-                if (full())
-                    erase();
-                cache_.push_front(key);
-                mp_[key].pop_front();
-                hash_[key] = cache_.begin();
-                return false;
-            }
+        template <typename F>
+        void for_each(F f) const {
+            for (const slot& s : slots_)
+                if (s.pos != empty)
+                    f(s.key, s.pos);
+        }
 
-            mp_[key].pop_front();
-            return true;
+    private:
+        struct slot {
+            KeyT key{};
+            PosT pos = empty;
+        };
+
+        size_t find_slot(const KeyT& key) const {
+            size_t mask = slots_.size() - 1;
+            size_t i = mix_hash(static_cast<std::uint64_t>(hasher_(key))) & mask;
+            while (slots_[i].pos != empty && !(slots_[i].key == key))
+                i = (i + 1) & mask;
+            return i;
         }
 
-        bool isPresent(KeyT key) const {
-            return hash_.find(key) != hash_.end();
+        void grow() {
+            std::vector<slot> old(2 * slots_.size());
+            std::swap(old, slots_);
+            for (const slot& s : old)
+                if (s.pos != empty)
+                    slots_[find_slot(s.key)] = s;
         }
 
-        void dump() const {
-            std::cout << "cache:";
-            for (auto x : cache_) {
-                std::cout << " " << x;
+    private:
+        std::vector<slot> slots_;
+        size_t size_ = 0;
+        [[no_unique_address]] Hash hasher_;
+    };
+
+    // next_use[i] is the position of the next request for the key requested at
+    // position i, or the maximum of PosT if it is never requested again. The
+    // result is n integers; the key -> position map only lives during the pass.
+    template <typename PosT, typename KeyT, typename Hash = std::hash<KeyT>, typename It>
+    std::vector<PosT> compute_next_use(It begin, It end) {
+        constexpr PosT never = std::numeric_limits<PosT>::max();
+        position_map<KeyT, PosT, Hash> seen;
+        std::vector<PosT> next_use;
+
+        if constexpr (std::bidirectional_iterator<It>) {
+            auto n = static_cast<size_t>(std::distance(begin, end));
+            if (n >= never)
+                throw std::length_error("trace is too long for the next-use position type");
+            next_use.resize(n);
+
+            // one backward pass: the last position seen for a key is its next use
+            for (size_t i = n; i-- > 0;) {
+                --end;
+                auto [pos, inserted] = seen.try_emplace(*end, static_cast<PosT>(i));
+                next_use[i] = inserted ? never : pos;
+                pos = static_cast<PosT>(i);
             }
-            std::cout << "\nmap: ";
-            for (auto x : mp_) {
-                std::cout << x.first << ":";
-                for (auto i : x.second) {
-                    std::cout << " " << i; 
+        } else {
+            // input iterators can only go forward: patch the previous occurrence instead
+            for (PosT i = 0; begin != end; ++begin, ++i) {
+                if (i == never)
+                    throw std::length_error("trace is too long for the next-use position type");
+                auto [pos, inserted] = seen.try_emplace(*begin, i);
+                if (!inserted) {
+                    next_use[pos] = i;
+                    pos = i;
                 }
-                std::cout << '\n';
+                next_use.push_back(never);
             }
-            std::cout << "\n";
         }
-    private:
-        void erase() {
-            ListIt elem;
-            int max = 0;
-            for (ListIt it = cache_.begin(); it != cache_.end(); ++it) {
-                auto find = mp_.find(*it);
-                if (find->second.empty()) {
-                    cache_.erase(it);
-                    hash_.erase(*it);
-                    return;
+        return next_use;
+    }
+
+    // keys of the iterator's own type, so that wide keys are never narrowed
+    template <typename PosT = std::uint32_t, typename It>
+    std::vector<PosT> compute_next_use(It begin, It end) {
+        using key_type = std::iter_value_t<It>;
+        return compute_next_use<PosT, key_type, std::hash<key_type>>(begin, end);
+    }
+
+    // compute_next_use on up to `threads` workers, with the same result. The
+    // trace is cut into one chunk per worker and each chunk gets the backward
+    // pass on its own, which resolves every position but the last occurrence
+    // of each key in the chunk. Those open positions and the first occurrence
+    // of every key in the chunk are then bucketed by key hash, one partition
+    // per worker. In the fix-up pass each worker takes one partition and walks
+    // the chunks from the end of the trace, keeping the first occurrence of
+    // each key in the chunks already walked: an open position's next use is
+    // the one recorded for its key, or never.
+    template <typename PosT = std::uint32_t, typename KeyT = int, typename Hash = std::hash<KeyT>>
+    std::vector<PosT> compute_next_use_parallel(std::span<const KeyT> keys,
+                                                size_t threads = std::thread::hardware_concurrency()) {
+        constexpr PosT never = std::numeric_limits<PosT>::max();
+        // below this per worker, starting threads costs more than the pass
+        constexpr size_t min_chunk = size_t{1} << 16;
+
+        size_t n = keys.size();
+        if (n >= never)
+            throw std::length_error("trace is too long for the next-use position type");
+        threads = std::clamp<size_t>(threads, 1, std::max<size_t>(n / min_chunk, 1));
+        if (threads == 1)
+            return compute_next_use<PosT, KeyT, Hash>(keys.begin(), keys.end());
+
+        struct first_use {
+            KeyT key;
+            PosT pos;
+        };
+        // what a chunk leaves for the fix-up, by partition
+        struct chunk_ends {
+            std::vector<std::vector<first_use>> firsts;
+            std::vector<std::vector<PosT>> open;
+        };
+
+        Hash hasher;
+        auto partition_of = [&](const KeyT& key) {
+            return static_cast<size_t>(((mix_hash(static_cast<std::uint64_t>(hasher(key))) >> 32) * threads) >> 32);
+        };
+
+        auto run = [threads](auto work) {
+            std::vector<std::exception_ptr> errors(threads);
+            auto guarded = [&](size_t t) {
+                try {
+                    work(t);
+                } catch (...) {
+                    errors[t] = std::current_exception();
                 }
+            };
+            std::vector<std::thread> pool;
+            for (size_t t = 1; t < threads; t++)
+                pool.emplace_back(guarded, t);
+            guarded(0);
+            for (auto& t : pool)
+                t.join();
+            for (auto& e : errors)
+                if (e)
+                    std::rethrow_exception(e);
+        };
+
+        std::vector<PosT> next_use(n);
+        std::vector<chunk_ends> chunks(threads);
 
-                if (max < find->second[0]) {
-                    elem = it;
-                    max = find->second[0];
+        run([&](size_t c) {
+            auto& ends = chunks[c];
+            ends.firsts.resize(threads);
+            ends.open.resize(threads);
+            position_map<KeyT, PosT, Hash> seen;
+            for (size_t i = n * (c + 1) / threads, lo = n * c / threads; i-- > lo;) {
+                auto [pos, inserted] = seen.try_emplace(keys[i], static_cast<PosT>(i));
+                if (inserted) {
+                    next_use[i] = never;
+                    ends.open[partition_of(keys[i])].push_back(static_cast<PosT>(i));
+                } else {
+                    next_use[i] = pos;
+                    pos = static_cast<PosT>(i);
                 }
             }
-            cache_.erase(elem);
-            hash_.erase(*elem);
+            seen.for_each([&](const KeyT& key, PosT pos) { ends.firsts[partition_of(key)].push_back(first_use{key, pos}); });
+        });
+
+        run([&](size_t p) {
+            position_map<KeyT, PosT, Hash> later;
+            for (size_t c = threads; c-- > 0;) {
+                for (PosT i : chunks[c].open[p])
+                    next_use[i] = later.find(keys[i]);
+                for (const auto& f : chunks[c].firsts[p])
+                    later.try_emplace(f.key, f.pos).first = f.pos;
+                // this chunk's share is done, give the memory back early
+                std::vector<PosT>().swap(chunks[c].open[p]);
+                std::vector<first_use>().swap(chunks[c].firsts[p]);
+            }
+        });
+        return next_use;
+    }
+
+    // Belady's choice as an eviction policy: the resident key whose next use is
+    // furthest away, keys never used again first. Every lookup consumes one
+    // position of the next-use array, so keys must come in trace order. The
+    // heap keeps the victim on top, so eviction is O(log size).
+    template <typename PosT = std::uint32_t>
+    class belady_policy {
+    public:
+        using index_type = std::uint32_t;
+        using node_data = no_node_data;
+
+        static constexpr PosT never = std::numeric_limits<PosT>::max();
+
+    public:
+        explicit belady_policy(std::vector<PosT> next_use = {}) : next_use_(std::move(next_use)) {}
+
+        void reserve(size_t capacity) { next_.reserve(capacity); }
+
+        template <typename Storage>
+        void inserted(Storage&, index_type i) { next_.push(i, advance()); }
+
+        template <typename Storage>
+        void accessed(Storage&, index_type i) { next_.update(i, advance()); }
+
+        template <typename Storage>
+        void erased(Storage&, index_type i) { next_.erase(i); }
+
+        template <typename Storage>
+        index_type victim(const Storage&) const { return next_.top(); }
+
+        void bypassed() { advance(); }
+
+        void clear() {
+            next_.clear();
+            pos_ = 0;
+        }
+
+        PosT next_use(index_type i) const { return next_.priority(i); }
+        size_t position() const { return pos_; }
+        size_t length() const { return next_use_.size(); }
+
+    private:
+        // consumes the current request and returns the next use of its key
+        PosT advance() {
+            return pos_ < next_use_.size() ? next_use_[pos_++] : never;
+        }
+
+    private:
+        size_t pos_ = 0;
+        std::vector<PosT> next_use_;
+        indexed_heap<PosT> next_;
+    };
+
+    // Belady's offline optimal cache. Keys must be looked up in the same order
+    // as they appear in the trace given to the constructor.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>, typename PosT = std::uint32_t>
+    class perfect_cache : public basic_cache<belady_policy<PosT>, slab_storage<KeyT>, open_index<KeyT, Hash>> {
+        using base = basic_cache<belady_policy<PosT>, slab_storage<KeyT>, open_index<KeyT, Hash>>;
+
+    public:
+        using size_type = size_t;
+        using pos_type = PosT;
+
+    public:
+        template <typename It>
+        perfect_cache(size_type size, It begin, It end) :
+            perfect_cache(size, compute_next_use<PosT, KeyT, Hash>(begin, end)) {}
+
+        perfect_cache(size_type size, std::vector<PosT> next_use) :
+            base(size, belady_policy<PosT>(std::move(next_use))) {}
+
+        void dump() const {
+            const auto& policy = this->policy();
+            std::cout << "cache:";
+            this->for_each([&](const KeyT& key, auto i) {
+                std::cout << " " << key << "(next ";
+                if (policy.next_use(i) == policy.never)
+                    std::cout << "never)";
+                else
+                    std::cout << policy.next_use(i) << ")";
+            });
+            std::cout << "\nposition: " << policy.position() << " of " << policy.length() << "\n";
+        }
+    };
+
+    // Belady generalized to objects of different sizes: on a miss the object
+    // is admitted, then keys are evicted furthest next use first until the
+    // cache fits its byte capacity again, which may evict the newcomer
+    // itself; objects never requested again are not admitted at all. With
+    // unit sizes that is Belady's choice when misses may bypass the cache, so
+    // it hits at least as often as perfect_cache. Exact offline optimality is
+    // NP-hard with sizes, so this is the reference the online byte-capacity
+    // caches are compared against rather than a strict upper bound. Keys must
+    // come in trace order, as for perfect_cache.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>, typename PosT = std::uint32_t>
+    class sized_perfect_cache {
+    public:
+        using size_type = size_t;
+        using pos_type = PosT;
+
+        static constexpr PosT never = std::numeric_limits<PosT>::max();
+
+    public:
+        template <typename It>
+        sized_perfect_cache(std::uint64_t capacity, It begin, It end) :
+            sized_perfect_cache(capacity, compute_next_use<PosT, KeyT, Hash>(begin, end)) {}
+
+        sized_perfect_cache(std::uint64_t capacity, std::vector<PosT> next_use) :
+            cap_{capacity}, next_use_(std::move(next_use)) {}
+
+        std::uint64_t capacity() const { return cap_; }
+        std::uint64_t used() const { return keys_.used(); }
+        size_type size() const { return keys_.size(); }
+
+        bool lookup_update(const KeyT& key) { return lookup_update_sized(key, 1); }
+
+        bool lookup_update_sized(const KeyT& key, std::uint64_t size) {
+            PosT next = pos_ < next_use_.size() ? next_use_[pos_++] : never;
+            auto h = keys_.hash(key);
+            if (auto i = keys_.find(key, h); i != keys_.npos) {
+                next_.update(i, next);
+                return true;
+            }
+            if (size > cap_ || next == never)
+                return false;
+
+            next_.push(keys_.insert(key, h, size), next);
+            while (keys_.used() > cap_)
+                keys_.erase(next_.pop());
+            return false;
+        }
+
+        void clear() {
+            keys_.clear();
+            next_.clear();
+            pos_ = 0;
         }
 
     private:
-        size_type size_;
-        std::unordered_map<KeyT, std::deque<size_type>> mp_;
+        struct node {
+            std::uint64_t size;
+        };
 
-        using ListIt = std::list<KeyT>::iterator;
-        std::unordered_map<KeyT, ListIt> hash_;
-        std::list<KeyT> cache_;
+        std::uint64_t cap_;
+        size_t pos_ = 0;
+        std::vector<PosT> next_use_;
+        sized_store<KeyT, Hash, node> keys_;
+        indexed_heap<PosT> next_;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,119 @@
+#include "replay.hpp"
+#include "trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace caches;
+
+namespace {
+    struct options {
+        std::vector<std::string> policies;
+        std::vector<size_t> capacities;
+        size_t points = 0;
+        size_t threads = std::thread::hardware_concurrency();
+        std::string file;
+    };
+
+    std::vector<std::string> split(const std::string& list) {
+        std::vector<std::string> items;
+        size_t start = 0;
+        for (size_t comma; (comma = list.find(',', start)) != std::string::npos; start = comma + 1)
+            items.push_back(list.substr(start, comma - start));
+        items.push_back(list.substr(start));
+        return items;
+    }
+
+    bool parse(int argc, char** argv, options& opts) {
+        int i = 1;
+        for (; i + 1 < argc; i += 2) {
+            std::string flag = argv[i];
+            if (flag == "--policies") {
+                if (std::string(argv[i + 1]) != "all")
+                    opts.policies = split(argv[i + 1]);
+            } else if (flag == "--capacities") {
+                for (const auto& c : split(argv[i + 1]))
+                    opts.capacities.push_back(std::strtoull(c.c_str(), nullptr, 10));
+            } else if (flag == "--points") {
+                opts.points = std::strtoull(argv[i + 1], nullptr, 10);
+            } else if (flag == "--threads") {
+                opts.threads = std::strtoull(argv[i + 1], nullptr, 10);
+            } else {
+                break;
+            }
+        }
+        if (i < argc)
+            opts.file = argv[i++];
+        return i == argc;
+    }
+}
+
+// Replays one trace through every combination of --policies (default: all)
+// and --capacities (default: the m of the trace; --points K takes K evenly
+// spaced capacities up to m instead) on --threads workers, then prints one
+// row per run. of_optimal compares against perfect at the same capacity when
+// perfect is among the policies.
+int main(int argc, char** argv) try {
+    options opts;
+    if (!parse(argc, argv, opts)) {
+        std::cerr << "usage: replay [--policies p1,p2,...|all] [--capacities c1,c2,... | --points K] [--threads N] [trace file]\n";
+        return 1;
+    }
+
+    auto input = opts.file.empty() ? trace::parse(std::cin) : trace::open(opts.file);
+    std::vector<int> keys;
+    keys.reserve(input.size());
+    for (auto q : input)
+        keys.push_back(int_key(q));
+    replay_trace shared(std::move(keys));
+
+    if (opts.policies.empty())
+        for (const auto& entry : policy_registry())
+            opts.policies.emplace_back(entry.name);
+    if (opts.capacities.empty()) {
+        size_t m = input.capacity();
+        for (size_t i = 1; i <= opts.points; i++)
+            opts.capacities.push_back(std::max<size_t>(1, m * i / opts.points));
+        if (opts.points == 0)
+            opts.capacities.push_back(m);
+    }
+
+    std::vector<replay_config> configs;
+    for (const auto& policy : opts.policies)
+        for (size_t capacity : opts.capacities)
+            configs.push_back({policy, capacity});
+
+    auto start = std::chrono::steady_clock::now();
+    auto results = replay_all(shared, configs, opts.threads);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::map<size_t, size_t> optimal;
+    for (const auto& r : results)
+        if (r.config.policy == "perfect")
+            optimal[r.config.capacity] = r.hits;
+
+    size_t requests = shared.keys().size();
+    double total = 0.0, slowest = 0.0;
+    std::printf("%-14s %10s %12s %9s %10s %9s\n", "policy", "capacity", "hits", "hit_ratio", "of_optimal", "seconds");
+    for (const auto& r : results) {
+        double ratio = requests ? static_cast<double>(r.hits) / requests : 0.0;
+        std::printf("%-14s %10zu %12zu %9.4f ", r.config.policy.c_str(), r.config.capacity, r.hits, ratio);
+        if (auto opt = optimal.find(r.config.capacity); opt != optimal.end() && opt->second > 0)
+            std::printf("%10.4f", static_cast<double>(r.hits) / opt->second);
+        else
+            std::printf("%10s", "-");
+        std::printf(" %9.3f\n", r.seconds);
+        total += r.seconds;
+        slowest = std::max(slowest, r.seconds);
+    }
+    std::printf("# %zu runs, wall %.3f s, slowest run %.3f s, sum of runs %.3f s\n", results.size(), wall, slowest, total);
+    return 0;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "arc.hpp"
+#include "basic_cache.hpp"
+#include "cache.hpp"
+#include "lirs.hpp"
+#include "lrucache.hpp"
+#include "perfectcache.hpp"
+#include "s3fifo.hpp"
+#include "sizedcache.hpp"
+#include "tinylfu.hpp"
+#include "twoqueue.hpp"
+
+// Replaying one trace through many policy/capacity configurations at once.
+// The trace is decoded once and shared read-only by all workers; every
+// configuration gets its own cache, so workers never share mutable state.
+namespace caches {
+    class replay_trace {
+    public:
+        explicit replay_trace(std::vector<int> keys) : keys_(std::move(keys)) {}
+
+        std::span<const int> keys() const { return keys_; }
+
+        // Belady's next-use array, computed by the first replay that needs it
+        const std::vector<std::uint32_t>& next_use() const {
+            std::call_once(once_, [this] { next_use_ = compute_next_use_parallel<std::uint32_t, int>(keys_); });
+            return next_use_;
+        }
+
+    private:
+        std::vector<int> keys_;
+        mutable std::once_flag once_;
+        mutable std::vector<std::uint32_t> next_use_;
+    };
+
+    // replays the whole trace through a cold cache and returns the hits
+    using replay_fn = size_t (*)(size_t capacity, const replay_trace& trace);
+
+    template <typename Cache>
+    size_t replay_with(size_t capacity, const replay_trace& trace) {
+        Cache cache(capacity);
+        return cache.lookup_update_batch(trace.keys());
+    }
+
+    inline size_t replay_perfect(size_t capacity, const replay_trace& trace) {
+        perfect_cache<int> cache(capacity, trace.next_use());
+        return cache.lookup_update_batch(trace.keys());
+    }
+
+    struct policy_entry {
+        std::string_view name;
+        replay_fn replay;
+    };
+
+    // Every policy the drivers know, by the name they use on the command line.
+    inline std::span<const policy_entry> policy_registry() {
+        static const policy_entry all[] = {
+            {"lru", replay_with<lru_cache<int>>},
+            {"fifo", replay_with<fifo_cache<int>>},
+            {"slru", replay_with<slru_cache<int>>},
+            {"lru2", replay_with<lru_2_cache<int>>},
+            {"lru2-adaptive", replay_with<adaptive_lru_2_cache<int>>},
+            {"2q", replay_with<two_q_cache<int>>},
+            {"arc", replay_with<arc_cache<int>>},
+            {"s3fifo", replay_with<s3fifo_cache<int>>},
+            {"lirs", replay_with<lirs_cache<int>>},
+            {"tinylfu", replay_with<tinylfu_cache<int>>},
+            {"gdsf", replay_with<gdsf_cache<int>>},
+            {"perfect", replay_perfect},
+        };
+        return all;
+    }
+
+    inline replay_fn find_policy(std::string_view name) {
+        for (const auto& entry : policy_registry())
+            if (entry.name == name)
+                return entry.replay;
+        return nullptr;
+    }
+
+    struct replay_config {
+        std::string policy;
+        size_t capacity = 0;
+    };
+
+    struct replay_result {
+        replay_config config;
+        size_t hits = 0;
+        double seconds = 0.0;
+    };
+
+    // Runs every configuration on up to `threads` workers and returns the
+    // results in configuration order. Belady and the largest caches are
+    // started first, so the slowest runs do not end up queued behind the rest.
+    inline std::vector<replay_result> replay_all(const replay_trace& trace, const std::vector<replay_config>& configs,
+                                                 size_t threads = std::thread::hardware_concurrency()) {
+        std::vector<replay_fn> fns;
+        for (const auto& config : configs) {
+            fns.push_back(find_policy(config.policy));
+            if (!fns.back())
+                throw std::invalid_argument("unknown policy " + config.policy);
+        }
+
+        std::vector<size_t> order(configs.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            bool pa = configs[a].policy == "perfect", pb = configs[b].policy == "perfect";
+            return pa != pb ? pa : configs[a].capacity > configs[b].capacity;
+        });
+
+        std::vector<replay_result> results(configs.size());
+        std::vector<std::exception_ptr> errors(configs.size());
+        std::atomic<size_t> next{0};
+        auto worker = [&] {
+            for (size_t n; (n = next.fetch_add(1, std::memory_order_relaxed)) < order.size();) {
+                size_t i = order[n];
+                results[i].config = configs[i];
+                try {
+                    auto start = std::chrono::steady_clock::now();
+                    results[i].hits = fns[i](configs[i].capacity, trace);
+                    results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+
+        threads = std::clamp<size_t>(threads, 1, std::max<size_t>(configs.size(), 1));
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool)
+            t.join();
+
+        for (auto& e : errors)
+            if (e)
+                std::rethrow_exception(e);
+        return results;
+    }
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+#include "batch.hpp"
+#include "slab.hpp"
+
+namespace caches {
+    // S3-FIFO (Yang et al., SOSP'23): three FIFO queues and no reordering on
+    // a hit. New keys enter a small FIFO holding 10% of the capacity. A key
+    // reaching its tail moves to the main FIFO if it was hit in the meantime,
+    // and is dropped into a ghost FIFO of keys otherwise. A key reaching the
+    // tail of main is evicted if its frequency is 0, and is reinserted at the
+    // head with the frequency decremented if not (lazy promotion). A miss on
+    // a ghost key goes straight to main. A hit only bumps a 2-bit counter in
+    // the node, so unlike LRU the hit path writes no links at all.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class s3fifo_cache {
+    public:
+        using size_type = size_t;
+        using hash_type = typename open_index<KeyT, Hash>::hash_type;
+
+        static constexpr std::uint8_t max_freq = 3;
+
+    public:
+        s3fifo_cache(size_type capacity, double small_fraction = 0.1) :
+            cap_{capacity},
+            small_cap_{capacity == 0 ? 0 : std::clamp<size_type>(static_cast<size_type>(capacity * small_fraction), 1, capacity)},
+            nodes_{capacity}, index_{capacity}, ghosts_{capacity - small_cap_} {}
+
+        size_type size() const { return nodes_.size(); }
+        size_type capacity() const { return cap_; }
+        bool full() const { return size() == cap_; }
+
+        size_type small_size() const { return small_size_; }
+        size_type main_size() const { return main_size_; }
+        size_type ghost_size() const { return ghosts_.size(); }
+
+        bool lookup_update(const KeyT& key) { return lookup_update(key, hash(key)); }
+        // h must be hash(key)
+        bool lookup_update(const KeyT& key, hash_type h);
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return index_.hash(key); }
+        // the ghost FIFO is only probed on a miss, like the ghost lists of arc_cache
+        void prefetch(hash_type h) const { index_.prefetch(h); }
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            if (auto i = find(key, h); i != npos)
+                nodes_.prefetch(i);
+        }
+
+        bool isPresent(const KeyT& key) const { return find(key, hash(key)) != npos; }
+        // true for keys resident in the main FIFO
+        bool isMain(const KeyT& key) const {
+            auto i = find(key, hash(key));
+            return i != npos && nodes_.data(i).main;
+        }
+
+        void clear() {
+            nodes_.clear();
+            index_.clear();
+            small_.clear();
+            main_.clear();
+            ghosts_.clear();
+            small_size_ = main_size_ = 0;
+        }
+
+    private:
+        struct node : list_links {
+            std::uint8_t freq;
+            bool main;
+        };
+
+        using storage_type = slab_storage<KeyT, node>;
+        using index_type = typename storage_type::index_type;
+
+        static constexpr index_type npos = storage_type::npos;
+
+        index_type find(const KeyT& key, hash_type h) const {
+            return index_.find(key, h, [this](index_type i) -> const KeyT& { return nodes_.key(i); });
+        }
+
+        void evict();
+
+        void erase(index_type i) {
+            index_.erase(nodes_.tag(i), i);
+            nodes_.release(i);
+        }
+
+        void remember(const KeyT& key) {
+            if (ghosts_.capacity() == 0)
+                return;
+            if (ghosts_.full())
+                ghosts_.pop_back();
+            ghosts_.push_front(key);
+        }
+
+    private:
+        size_type cap_;
+        size_type small_cap_;
+        storage_type nodes_;
+        open_index<KeyT, Hash> index_;
+        intrusive_list small_;
+        intrusive_list main_;
+        size_type small_size_ = 0;
+        size_type main_size_ = 0;
+        // keys only, as many as main can hold
+        slab_list<KeyT, Hash> ghosts_;
+    };
+
+    template <typename KeyT, typename Hash>
+    bool s3fifo_cache<KeyT, Hash>::lookup_update(const KeyT& key, hash_type h) {
+        if (auto i = find(key, h); i != npos) {
+            auto& freq = nodes_.data(i).freq;
+            if (freq < max_freq)
+                freq++;
+            return true;
+        }
+
+        if (cap_ == 0)
+            return false;
+
+        // looked up before evicting, which may push the oldest ghost out
+        bool ghost = false;
+        if (auto g = ghosts_.find(key, h); g != ghosts_.npos) {
+            ghosts_.erase(g);
+            ghost = true;
+        }
+        if (full())
+            evict();
+
+        index_type i = nodes_.allocate(key, static_cast<std::uint32_t>(h));
+        index_.insert(h, i);
+        auto& n = nodes_.data(i);
+        n.freq = 0;
+        n.main = ghost;
+        if (ghost) {
+            main_.link_front(nodes_, i);
+            main_size_++;
+        } else {
+            small_.link_front(nodes_, i);
+            small_size_++;
+        }
+        return false;
+    }
+
+    // Frees exactly one slot. Small is drained while it is over its share;
+    // keys moved to main or reinserted there keep the loop going, and each
+    // of those moves uses up a hit, so it ends.
+    template <typename KeyT, typename Hash>
+    void s3fifo_cache<KeyT, Hash>::evict() {
+        for (;;) {
+            if (small_size_ >= small_cap_ || main_size_ == 0) {
+                index_type t = small_.back();
+                small_.unlink(nodes_, t);
+                small_size_--;
+                auto& n = nodes_.data(t);
+                if (n.freq > 0) {
+                    n.freq = 0;
+                    n.main = true;
+                    main_.link_front(nodes_, t);
+                    main_size_++;
+                    continue;
+                }
+                remember(nodes_.key(t));
+                erase(t);
+                return;
+            }
+
+            index_type t = main_.back();
+            auto& n = nodes_.data(t);
+            if (n.freq > 0) {
+                n.freq--;
+                main_.move_to_front(nodes_, t);
+                continue;
+            }
+            main_.unlink(nodes_, t);
+            main_size_--;
+            erase(t);
+            return;
+        }
+    }
+}
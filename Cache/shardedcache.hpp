@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "cache.hpp"
+#include "slab.hpp"
+
+namespace caches {
+    // N independent lru_2_cache shards, each behind its own mutex. A key always
+    // lands in the same shard, so lookups of keys in different shards never
+    // contend. Shards are picked from the high bits of the mixed hash while the
+    // slab index inside a shard uses the low bits, keeping both well spread.
+    template<typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class sharded_lru_2_cache {
+    public:
+        using size_type = size_t;
+
+        struct statistics {
+            size_type hits = 0;
+            size_type misses = 0;
+
+            size_type lookups() const { return hits + misses; }
+            double hit_ratio() const { return lookups() ? static_cast<double>(hits) / lookups() : 0.0; }
+        };
+
+    public:
+        sharded_lru_2_cache(size_type capacity, size_type shards = 16) : count_{shards} {
+            if (shards == 0)
+                throw std::invalid_argument("sharded_lru_2_cache needs at least one shard");
+
+            shards_ = std::make_unique<shard[]>(shards);
+            for (size_type i = 0; i < shards; i++)
+                shards_[i].init(capacity / shards + (i < capacity % shards));
+        }
+
+        bool lookup_update(KeyT key) {
+            shard& s = shard_of(key);
+            bool hit;
+            {
+                std::lock_guard lock{s.mutex};
+                hit = s.cache->lookup_update(key);
+            }
+            (hit ? s.hits : s.misses).fetch_add(1, std::memory_order_relaxed);
+            return hit;
+        }
+
+        // Groups the batch by shard and runs each group through its shard's
+        // lookup_update_batch under a single lock. Keys of one shard keep their
+        // order and shards are independent, so the result is that of calling
+        // lookup_update key by key.
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            if (!hits.empty() && hits.size() != keys.size())
+                throw std::invalid_argument("hits must be empty or as long as the batch");
+
+            // counting sort of the batch positions by shard
+            std::vector<size_type> first(count_ + 1, 0);
+            std::vector<std::uint32_t> shardOf(keys.size());
+            for (size_type i = 0; i < keys.size(); i++) {
+                shardOf[i] = static_cast<std::uint32_t>(index_of(keys[i]));
+                first[shardOf[i] + 1]++;
+            }
+            for (size_type i = 0; i < count_; i++)
+                first[i + 1] += first[i];
+            std::vector<size_type> order(keys.size());
+            std::vector<KeyT> grouped(keys.size());
+            std::vector<size_type> fill(first.begin(), first.end() - 1);
+            for (size_type i = 0; i < keys.size(); i++) {
+                size_type at = fill[shardOf[i]]++;
+                order[at] = i;
+                grouped[at] = keys[i];
+            }
+
+            std::unique_ptr<bool[]> groupedHits(hits.empty() ? nullptr : new bool[keys.size()]);
+            size_type total = 0;
+            for (size_type i = 0; i < count_; i++) {
+                size_type n = first[i + 1] - first[i];
+                if (n == 0)
+                    continue;
+                shard& s = shards_[i];
+                size_type h;
+                {
+                    std::lock_guard lock{s.mutex};
+                    h = s.cache->lookup_update_batch(std::span<const KeyT>(grouped.data() + first[i], n),
+                                                     hits.empty() ? std::span<bool>{} : std::span<bool>(groupedHits.get() + first[i], n));
+                }
+                s.hits.fetch_add(h, std::memory_order_relaxed);
+                s.misses.fetch_add(n - h, std::memory_order_relaxed);
+                total += h;
+            }
+
+            if (!hits.empty())
+                for (size_type at = 0; at < keys.size(); at++)
+                    hits[order[at]] = groupedHits[at];
+            return total;
+        }
+
+        bool isPresent(KeyT key) const {
+            const shard& s = shard_of(key);
+            std::lock_guard lock{s.mutex};
+            return s.cache->isPresent(key);
+        }
+
+        bool full() const {
+            for (size_type i = 0; i < count_; i++) {
+                std::lock_guard lock{shards_[i].mutex};
+                if (!shards_[i].cache->full())
+                    return false;
+            }
+            return true;
+        }
+
+        size_type shard_count() const { return count_; }
+
+        statistics shard_statistics(size_type i) const {
+            return {shards_[i].hits.load(std::memory_order_relaxed), shards_[i].misses.load(std::memory_order_relaxed)};
+        }
+
+        // Counters are read without locking, so a snapshot taken while other
+        // threads run may be off by the lookups in flight.
+        statistics stats() const {
+            statistics total;
+            for (size_type i = 0; i < count_; i++) {
+                auto s = shard_statistics(i);
+                total.hits += s.hits;
+                total.misses += s.misses;
+            }
+            return total;
+        }
+
+    private:
+        // one cache line per shard header so neighbouring locks do not false-share
+        struct alignas(64) shard {
+            mutable std::mutex mutex;
+            std::optional<lru_2_cache<KeyT, Hash>> cache;
+            std::atomic<size_type> hits{0};
+            std::atomic<size_type> misses{0};
+
+            void init(size_type capacity) { cache.emplace(capacity); }
+        };
+
+        size_type index_of(const KeyT& key) const {
+            std::uint64_t h = mix_hash(static_cast<std::uint64_t>(hasher_(key)));
+            return static_cast<size_type>(((h >> 32) * count_) >> 32);
+        }
+
+        shard& shard_of(const KeyT& key) { return shards_[index_of(key)]; }
+        const shard& shard_of(const KeyT& key) const { return shards_[index_of(key)]; }
+
+    private:
+        size_type count_;
+        std::unique_ptr<shard[]> shards_;
+        [[no_unique_address]] Hash hasher_;
+    };
+}
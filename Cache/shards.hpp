@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "mrc.hpp"
+#include "slab.hpp"
+
+// SHARDS (Waldspurger et al., FAST'15): approximate miss-ratio curves from a
+// spatially hashed sample of the key space. A key is either always or never
+// sampled, so reuse distances inside the sample are those of the full trace
+// scaled by the sampling rate.
+//
+// Every estimate is computed twice: once from the whole sample and once from
+// `replicates` disjoint sub-samples (split by other hash bits). The spread of
+// the replicates gives the reported error: 1.96 standard errors, i.e. an
+// approximate 95% interval around the full-sample estimate.
+namespace caches {
+    // Sampling decisions use the top 24 bits of the mixed hash and replicate ids
+    // the 8 bits below them, leaving the low 32 bits (used by open_index) unbiased
+    // for the miniature caches that only ever see sampled keys.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class spatial_sampler {
+    public:
+        using size_type = size_t;
+
+        static constexpr std::uint64_t modulus = 1 << 24;
+
+    public:
+        spatial_sampler(double rate) {
+            if (!(rate > 0.0 && rate <= 1.0))
+                throw std::invalid_argument("sampling rate must be in (0, 1]");
+            threshold_ = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::llround(rate * modulus)));
+        }
+
+        std::uint64_t hash(const KeyT& key) const { return mix_hash(static_cast<std::uint64_t>(hasher_(key))); }
+
+        static std::uint64_t value(std::uint64_t h) { return h >> 40; }
+        static size_type replicate(std::uint64_t h, size_type replicates) { return ((h >> 32) & 0xff) % replicates; }
+
+        bool sampled(std::uint64_t h) const { return value(h) < threshold_; }
+
+        std::uint64_t threshold() const { return threshold_; }
+        void set_threshold(std::uint64_t threshold) { threshold_ = threshold; }
+
+        double rate() const { return static_cast<double>(threshold_) / modulus; }
+
+    private:
+        std::uint64_t threshold_;
+        [[no_unique_address]] Hash hasher_;
+    };
+
+    // Weighted histogram of scaled reuse distances. Buckets double in width when
+    // more than max_buckets would be needed, so memory is bounded whatever the
+    // key space.
+    class scaled_histogram {
+    public:
+        using size_type = size_t;
+    public:
+        scaled_histogram(size_type max_buckets = 4096) : max_{max_buckets} {}
+
+        // bucket i holds distances in (i * width, (i + 1) * width]
+        void add(double distance, double weight) {
+            size_type bucket = index(distance);
+            while (bucket >= max_) {
+                merge();
+                bucket = index(distance);
+            }
+            if (bucket >= buckets_.size())
+                buckets_.resize(bucket + 1, 0.0);
+            buckets_[bucket] += weight;
+        }
+
+        void scale(double factor) {
+            for (auto& b : buckets_)
+                b *= factor;
+        }
+
+        // weight of distances not above capacity; the bucket holding capacity
+        // is interpolated linearly
+        double below(double capacity) const {
+            double total = 0.0;
+            for (size_type i = 0; i < buckets_.size(); i++) {
+                double lo = i * width_, hi = lo + width_;
+                if (hi <= capacity) {
+                    total += buckets_[i];
+                } else {
+                    if (lo < capacity)
+                        total += buckets_[i] * (capacity - lo) / width_;
+                    break;
+                }
+            }
+            return total;
+        }
+
+    private:
+        size_type index(double distance) const {
+            double i = std::ceil(distance / width_) - 1.0;
+            return i > 0.0 ? static_cast<size_type>(i) : 0;
+        }
+
+        void merge() {
+            std::vector<double> merged((buckets_.size() + 1) / 2, 0.0);
+            for (size_type i = 0; i < buckets_.size(); i++)
+                merged[i / 2] += buckets_[i];
+            buckets_ = std::move(merged);
+            width_ *= 2;
+        }
+
+    private:
+        size_type max_;
+        double width_ = 1.0;
+        std::vector<double> buckets_;
+    };
+
+    struct mrc_point {
+        size_t capacity;
+        double miss_ratio;
+        double error;
+    };
+
+    // LRU miss-ratio curve in the fixed-rate or fixed-size flavour of SHARDS.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class shards_lru {
+    public:
+        using size_type = size_t;
+
+    public:
+        // samples a constant fraction of the key space; memory grows with
+        // rate * distinct keys
+        static shards_lru fixed_rate(double rate, size_type replicates = 8) {
+            return shards_lru(rate, 0, replicates);
+        }
+
+        // tracks at most max_keys keys, lowering the rate as new keys show up
+        static shards_lru fixed_size(size_type max_keys, double initial_rate = 0.1, size_type replicates = 8) {
+            if (max_keys < replicates)
+                throw std::invalid_argument("fixed-size SHARDS needs at least one key per replicate");
+            return shards_lru(initial_rate, max_keys, replicates);
+        }
+
+        void access(const KeyT& key) {
+            requests_++;
+            std::uint64_t h = sampler_.hash(key);
+            if (!sampler_.sampled(h))
+                return;
+            main_.access(key, h, sampler_);
+            replicates_[sampler_.replicate(h, replicates_.size())].access(key, h, sampler_);
+        }
+
+        size_type requests() const { return requests_; }
+        double rate() const { return main_.rate(); }
+        size_type sampled_keys() const { return main_.distances.distinct(); }
+
+        std::vector<mrc_point> curve(const std::vector<size_type>& capacities) const {
+            std::vector<mrc_point> points;
+            double k = static_cast<double>(replicates_.size());
+            for (size_type c : capacities) {
+                double mean = 0.0, sq = 0.0;
+                for (const auto& r : replicates_) {
+                    double m = r.miss_ratio(c, requests_);
+                    mean += m;
+                    sq += m * m;
+                }
+                mean /= k;
+                double var = k > 1 ? std::max(0.0, (sq - k * mean * mean) / (k - 1)) : 0.0;
+                points.push_back({c, main_.miss_ratio(c, requests_), 1.96 * std::sqrt(var / k)});
+            }
+            return points;
+        }
+
+    private:
+        struct estimator {
+            stack_distance_analyzer<KeyT, Hash> distances{1 << 10};
+            scaled_histogram histogram;
+            std::uint64_t threshold;
+            double sampled = 0.0;
+            size_type max_keys;
+            // fixed size: tracked keys by sampling value, largest on top
+            std::priority_queue<std::pair<std::uint64_t, KeyT>> tracked;
+            // fixed rate: this estimator sees a 1/share part of the sampled keys
+            double share;
+
+            double rate() const { return static_cast<double>(threshold) / spatial_sampler<KeyT, Hash>::modulus / share; }
+
+            void access(const KeyT& key, std::uint64_t h, const spatial_sampler<KeyT, Hash>& sampler) {
+                std::uint64_t value = sampler.value(h);
+                if (value >= threshold)
+                    return;
+
+                sampled += 1.0;
+                size_type d = distances.access(key);
+                if (d != distances.cold) {
+                    histogram.add(d / rate(), 1.0);
+                    return;
+                }
+                if (max_keys == 0)
+                    return;
+
+                tracked.emplace(value, key);
+                if (tracked.size() <= max_keys)
+                    return;
+
+                // evict the keys with the largest value and lower the threshold
+                // to it; counts collected at the old rate are rescaled
+                std::uint64_t old = threshold;
+                threshold = tracked.top().first;
+                while (!tracked.empty() && tracked.top().first >= threshold) {
+                    distances.forget(tracked.top().second);
+                    tracked.pop();
+                }
+                double factor = static_cast<double>(threshold) / old;
+                histogram.scale(factor);
+                sampled *= factor;
+            }
+
+            double miss_ratio(size_type capacity, double requests) const {
+                // SHARDS_adj: in fixed-rate mode, the gap between the expected
+                // and the actual number of sampled references goes to the
+                // smallest distances
+                double total = sampled, hits = histogram.below(static_cast<double>(capacity));
+                if (max_keys == 0) {
+                    double expected = requests * rate();
+                    hits += expected - sampled;
+                    total = expected;
+                }
+                if (total <= 0.0)
+                    return 1.0;
+                return std::clamp(1.0 - hits / total, 0.0, 1.0);
+            }
+        };
+
+        shards_lru(double rate, size_type max_keys, size_type replicates) : sampler_{rate} {
+            if (replicates == 0 || replicates > 256)
+                throw std::invalid_argument("SHARDS needs between 1 and 256 replicates");
+            main_ = make_estimator(max_keys, 1.0);
+            for (size_type i = 0; i < replicates; i++)
+                replicates_.push_back(make_estimator(max_keys / replicates, static_cast<double>(replicates)));
+        }
+
+        estimator make_estimator(size_type max_keys, double share) const {
+            estimator e;
+            e.threshold = sampler_.threshold();
+            e.max_keys = max_keys;
+            e.share = share;
+            return e;
+        }
+
+    private:
+        spatial_sampler<KeyT, Hash> sampler_;
+        estimator main_;
+        std::vector<estimator> replicates_;
+        size_type requests_ = 0;
+    };
+
+    // Miniature simulation (Waldspurger et al., ATC'17) for policies without the
+    // stack property, such as the 2Q caches: every capacity c is modelled by a
+    // Cache of capacity c * rate fed with the fixed-rate sample. Memory is the
+    // sum of the miniature capacities, independent of the trace length.
+    template <typename Cache, typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class shards_sim {
+    public:
+        using size_type = size_t;
+
+    public:
+        shards_sim(double rate, const std::vector<size_type>& capacities, size_type replicates = 8) :
+            shards_sim(rate, capacities, replicates, [](size_type c) { return std::make_unique<Cache>(c); }) {}
+
+        // make(c) builds a miniature cache of capacity c, for caches that take
+        // more than a capacity; it must scale any other size parameter itself
+        template <typename Make>
+        shards_sim(double rate, const std::vector<size_type>& capacities, size_type replicates, Make make) :
+            sampler_{rate}, replicates_{replicates} {
+            if (replicates == 0 || replicates > 256)
+                throw std::invalid_argument("SHARDS needs between 1 and 256 replicates");
+            for (size_type c : capacities) {
+                point p{c, make(scaled(c, sampler_.rate())), 0, {}};
+                for (size_type i = 0; i < replicates; i++)
+                    p.replicas.push_back({make(scaled(c, sampler_.rate() / replicates))});
+                points_.push_back(std::move(p));
+            }
+        }
+
+        void access(const KeyT& key) {
+            requests_++;
+            std::uint64_t h = sampler_.hash(key);
+            if (!sampler_.sampled(h))
+                return;
+            size_type r = sampler_.replicate(h, replicates_);
+            for (auto& p : points_) {
+                p.main_misses += !p.main->lookup_update(key);
+                p.replicas[r].misses += !p.replicas[r].cache->lookup_update(key);
+            }
+            sampled_++;
+        }
+
+        double rate() const { return sampler_.rate(); }
+        size_type sampled() const { return sampled_; }
+
+        std::vector<mrc_point> curve() const {
+            std::vector<mrc_point> result;
+            double k = static_cast<double>(replicates_);
+            for (const auto& p : points_) {
+                double mean = 0.0, sq = 0.0;
+                for (const auto& r : p.replicas) {
+                    double m = miss_ratio(r.misses, sampler_.rate() / k);
+                    mean += m;
+                    sq += m * m;
+                }
+                mean /= k;
+                double var = k > 1 ? std::max(0.0, (sq - k * mean * mean) / (k - 1)) : 0.0;
+                result.push_back({p.capacity, miss_ratio(p.main_misses, sampler_.rate()), 1.96 * std::sqrt(var / k)});
+            }
+            return result;
+        }
+
+    private:
+        // Misses are scaled up by 1/rate and divided by the whole request count
+        // rather than by the sampled one: like SHARDS_adj, this treats a sample
+        // that missed (or caught) a few very hot keys as hits at short distance.
+        double miss_ratio(size_type misses, double rate) const {
+            double expected = requests_ * rate;
+            return expected > 0.0 ? std::clamp(misses / expected, 0.0, 1.0) : 1.0;
+        }
+
+        static size_type scaled(size_type capacity, double rate) {
+            return std::max<size_type>(1, static_cast<size_type>(std::llround(capacity * rate)));
+        }
+
+        struct replica {
+            std::unique_ptr<Cache> cache;
+            size_type misses = 0;
+        };
+
+        struct point {
+            size_type capacity;
+            std::unique_ptr<Cache> main;
+            size_type main_misses = 0;
+            std::vector<replica> replicas;
+        };
+
+    private:
+        spatial_sampler<KeyT, Hash> sampler_;
+        size_type replicates_;
+        std::vector<point> points_;
+        size_type sampled_ = 0;
+        size_type requests_ = 0;
+    };
+}
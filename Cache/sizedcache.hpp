@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+#include "batch.hpp"
+#include "heap.hpp"
+#include "slab.hpp"
+
+// Caches whose capacity is a number of bytes rather than of keys. Every
+// lookup carries the size of the object (any unit, as long as capacity uses
+// the same one) and goes through lookup_update_sized; an object larger than
+// the whole cache is never admitted. Plain lookup_update counts as one unit,
+// which turns the capacity back into a number of keys.
+namespace caches {
+    // The resident keys of a byte-capacity cache: a slab_storage whose Data
+    // payload has a `size` field, an open_index, and the bytes in use. The
+    // number of keys is not bounded by the capacity, so the index grows by
+    // doubling as keys come in.
+    template <typename KeyT, typename Hash, typename Data>
+    class sized_store {
+    public:
+        using size_type = size_t;
+        using storage_type = slab_storage<KeyT, Data>;
+        using index_type = typename storage_type::index_type;
+        using hash_type = typename open_index<KeyT, Hash>::hash_type;
+
+        static constexpr index_type npos = storage_type::npos;
+        static constexpr size_type initial_keys = 1024;
+
+    public:
+        sized_store() : index_{initial_keys} {}
+
+        size_type size() const { return storage_.size(); }
+        std::uint64_t used() const { return used_; }
+
+        hash_type hash(const KeyT& key) const { return index_.hash(key); }
+
+        index_type find(const KeyT& key, hash_type h) const {
+            return index_.find(key, h, [this](index_type i) -> const KeyT& { return storage_.key(i); });
+        }
+
+        index_type insert(const KeyT& key, hash_type h, std::uint64_t size) {
+            if (size_type n = storage_.size() + 1; n > reserved_) {
+                reserved_ = 2 * n;
+                index_.reserve(reserved_);
+            }
+            index_type i = storage_.allocate(key, static_cast<std::uint32_t>(h));
+            index_.insert(h, i);
+            storage_.data(i).size = size;
+            used_ += size;
+            return i;
+        }
+
+        void erase(index_type i) {
+            used_ -= storage_.data(i).size;
+            index_.erase(storage_.tag(i), i);
+            storage_.release(i);
+        }
+
+        void clear() {
+            storage_.clear();
+            index_.clear();
+            used_ = 0;
+        }
+
+        storage_type& storage() { return storage_; }
+        const storage_type& storage() const { return storage_; }
+
+        void prefetch(hash_type h) const { index_.prefetch(h); }
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            if (auto i = find(key, h); i != npos)
+                storage_.prefetch(i);
+        }
+
+    private:
+        storage_type storage_;
+        open_index<KeyT, Hash> index_;
+        size_type reserved_ = initial_keys;
+        std::uint64_t used_ = 0;
+    };
+
+    // LRU over bytes: evicts from the tail until the new object fits.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class sized_lru_cache {
+    public:
+        using size_type = size_t;
+        using hash_type = typename open_index<KeyT, Hash>::hash_type;
+
+    public:
+        sized_lru_cache(std::uint64_t capacity) : cap_{capacity} {}
+
+        std::uint64_t capacity() const { return cap_; }
+        std::uint64_t used() const { return keys_.used(); }
+        size_type size() const { return keys_.size(); }
+
+        bool isPresent(const KeyT& key) const { return keys_.find(key, hash(key)) != keys_.npos; }
+
+        bool lookup_update(const KeyT& key) { return lookup_update_sized(key, hash(key), 1); }
+        // h must be hash(key)
+        bool lookup_update(const KeyT& key, hash_type h) { return lookup_update_sized(key, h, 1); }
+
+        bool lookup_update_sized(const KeyT& key, std::uint64_t size) { return lookup_update_sized(key, hash(key), size); }
+        bool lookup_update_sized(const KeyT& key, hash_type h, std::uint64_t size) {
+            auto& s = keys_.storage();
+            if (auto i = keys_.find(key, h); i != keys_.npos) {
+                order_.move_to_front(s, i);
+                return true;
+            }
+            if (size > cap_)
+                return false;
+
+            while (keys_.used() + size > cap_) {
+                auto victim = order_.back();
+                order_.unlink(s, victim);
+                keys_.erase(victim);
+            }
+            order_.link_front(s, keys_.insert(key, h, size));
+            return false;
+        }
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return keys_.hash(key); }
+        void prefetch(hash_type h) const { keys_.prefetch(h); }
+        void prefetch_entry(const KeyT& key, hash_type h) const { keys_.prefetch_entry(key, h); }
+
+        void clear() {
+            keys_.clear();
+            order_.clear();
+        }
+
+    private:
+        struct node : list_links {
+            std::uint64_t size;
+        };
+
+        std::uint64_t cap_;
+        sized_store<KeyT, Hash, node> keys_;
+        intrusive_list order_;
+    };
+
+    // GreedyDual-Size-Frequency (Cherkasova, 1998). A key's priority is
+    //   H = L + frequency * cost / size
+    // and the key with the lowest H is evicted, raising the inflation value L
+    // to that H. Small, often used and expensive objects stay; keys that stop
+    // being used fall behind the L that newcomers start from. The cost of a
+    // miss defaults to 1, which maximizes the object hit ratio; passing the
+    // size as the cost maximizes the byte hit ratio instead.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class gdsf_cache {
+    public:
+        using size_type = size_t;
+        using hash_type = typename open_index<KeyT, Hash>::hash_type;
+
+    public:
+        gdsf_cache(std::uint64_t capacity) : cap_{capacity} {}
+
+        std::uint64_t capacity() const { return cap_; }
+        std::uint64_t used() const { return keys_.used(); }
+        size_type size() const { return keys_.size(); }
+        double inflation() const { return inflation_; }
+
+        bool isPresent(const KeyT& key) const { return keys_.find(key, hash(key)) != keys_.npos; }
+
+        bool lookup_update(const KeyT& key) { return lookup_update_sized(key, hash(key), 1, 1.0); }
+        // h must be hash(key)
+        bool lookup_update(const KeyT& key, hash_type h) { return lookup_update_sized(key, h, 1, 1.0); }
+
+        // size and cost only matter on a miss
+        bool lookup_update_sized(const KeyT& key, std::uint64_t size, double cost = 1.0) {
+            return lookup_update_sized(key, hash(key), size, cost);
+        }
+        bool lookup_update_sized(const KeyT& key, hash_type h, std::uint64_t size, double cost) {
+            auto& s = keys_.storage();
+            if (auto i = keys_.find(key, h); i != keys_.npos) {
+                auto& n = s.data(i);
+                n.freq++;
+                priority_.update(i, priority(n));
+                return true;
+            }
+            if (size > cap_)
+                return false;
+
+            while (keys_.used() + size > cap_) {
+                auto victim = priority_.top();
+                inflation_ = priority_.priority(victim);
+                priority_.pop();
+                keys_.erase(victim);
+            }
+            auto i = keys_.insert(key, h, size);
+            auto& n = s.data(i);
+            n.freq = 1;
+            n.cost = cost;
+            priority_.push(i, priority(n));
+            return false;
+        }
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return keys_.hash(key); }
+        void prefetch(hash_type h) const { keys_.prefetch(h); }
+        void prefetch_entry(const KeyT& key, hash_type h) const { keys_.prefetch_entry(key, h); }
+
+        void clear() {
+            keys_.clear();
+            priority_.clear();
+            inflation_ = 0.0;
+        }
+
+    private:
+        struct node {
+            std::uint64_t size;
+            std::uint64_t freq;
+            double cost;
+        };
+
+        double priority(const node& n) const {
+            // a zero-sized object costs nothing to keep
+            return inflation_ + static_cast<double>(n.freq) * n.cost / static_cast<double>(n.size ? n.size : 1);
+        }
+
+    private:
+        std::uint64_t cap_;
+        double inflation_ = 0.0;
+        sized_store<KeyT, Hash, node> keys_;
+        indexed_heap<double, std::greater<double>> priority_;
+    };
+}
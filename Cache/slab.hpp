@@ -0,0 +1,461 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace caches {
+    // splitmix64 finalizer: std::hash of integers is the identity, which clusters
+    // badly in power-of-two tables
+    inline std::uint64_t mix_hash(std::uint64_t h) {
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+
+    // Hash index with linear probing. Each slot keeps the low 32 bits of the mixed
+    // hash and the slab index of the node, so probing rarely touches the nodes
+    // themselves and deletion (backward shift) never has to rehash a key.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class open_index {
+    public:
+        using size_type = size_t;
+        using index_type = std::uint32_t;
+        using hash_type = std::uint64_t;
+
+        static constexpr index_type npos = std::numeric_limits<index_type>::max();
+
+    public:
+        open_index(size_type capacity) { slots_.resize(table_size(capacity)); mask_ = slots_.size() - 1; }
+
+        hash_type hash(const KeyT& key) const { return mix_hash(static_cast<hash_type>(hasher_(key))); }
+
+        template <typename KeyOf>
+        index_type find(const KeyT& key, hash_type h, KeyOf keyOf) const {
+            std::uint32_t tag = static_cast<std::uint32_t>(h);
+            for (size_type i = tag & mask_;; i = (i + 1) & mask_) {
+                const slot& s = slots_[i];
+                if (s.node == npos)
+                    return npos;
+                if (s.tag == tag && keyOf(s.node) == key)
+                    return s.node;
+            }
+        }
+
+        void insert(hash_type h, index_type node) {
+            std::uint32_t tag = static_cast<std::uint32_t>(h);
+            size_type i = tag & mask_;
+            while (slots_[i].node != npos)
+                i = (i + 1) & mask_;
+            slots_[i] = slot{tag, node};
+        }
+
+        void erase(std::uint32_t tag, index_type node);
+
+        void prefetch(hash_type h) const {
+            __builtin_prefetch(&slots_[static_cast<std::uint32_t>(h) & mask_]);
+        }
+
+        void clear() { std::fill(slots_.begin(), slots_.end(), slot{}); }
+
+        // Tables never shrink: only the owner knows when the live set got smaller.
+        void reserve(size_type capacity);
+
+    private:
+        static size_type table_size(size_type capacity) {
+            size_type size = 2;
+            while (size < 2 * capacity)
+                size *= 2;
+            return size;
+        }
+
+    private:
+        struct slot {
+            std::uint32_t tag = 0;
+            index_type node = npos;
+        };
+
+        std::vector<slot> slots_;
+        size_type mask_;
+        [[no_unique_address]] Hash hasher_;
+    };
+
+    template <typename KeyT, typename Hash>
+    void open_index<KeyT, Hash>::erase(std::uint32_t tag, index_type node) {
+        size_type i = tag & mask_;
+        while (slots_[i].node != node)
+            i = (i + 1) & mask_;
+
+        // backward shift: pull later entries of the probe run into the hole
+        for (size_type j = (i + 1) & mask_; slots_[j].node != npos; j = (j + 1) & mask_) {
+            size_type home = slots_[j].tag & mask_;
+            bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+            if (movable) {
+                slots_[i] = slots_[j];
+                i = j;
+            }
+        }
+        slots_[i] = slot{};
+    }
+
+    template <typename KeyT, typename Hash>
+    void open_index<KeyT, Hash>::reserve(size_type capacity) {
+        size_type size = table_size(capacity);
+        if (size <= slots_.size())
+            return;
+
+        std::vector<slot> old(size);
+        std::swap(old, slots_);
+        mask_ = slots_.size() - 1;
+        for (const slot& s : old) {
+            if (s.node == npos)
+                continue;
+            size_type i = s.tag & mask_;
+            while (slots_[i].node != npos)
+                i = (i + 1) & mask_;
+            slots_[i] = s;
+        }
+    }
+
+    // The key space of a direct_index: keys are integers in [0, size).
+    struct key_universe {
+        std::size_t size;
+    };
+
+    // Index for dense integral keys: a flat array with the slab index of every
+    // possible key, so a lookup is one bounds check and one load and there is
+    // nothing to hash or probe. The array costs 4 bytes per key of the
+    // universe whatever the capacity; keys outside it are rejected by hash(),
+    // before the cache changes anything.
+    template <typename KeyT = int>
+    class direct_index {
+        static_assert(std::is_integral_v<KeyT>, "direct_index needs integral keys");
+
+    public:
+        using size_type = size_t;
+        using index_type = std::uint32_t;
+        using hash_type = std::uint64_t;
+
+        static constexpr index_type npos = std::numeric_limits<index_type>::max();
+
+    public:
+        explicit direct_index(key_universe universe) : slots_(checked_size(universe), npos) {}
+
+        // the key itself
+        hash_type hash(const KeyT& key) const {
+            if constexpr (std::is_signed_v<KeyT>)
+                if (key < 0)
+                    throw std::out_of_range("key outside the universe of direct_index");
+            auto h = static_cast<hash_type>(static_cast<std::make_unsigned_t<KeyT>>(key));
+            if (h >= slots_.size())
+                throw std::out_of_range("key outside the universe of direct_index");
+            return h;
+        }
+
+        template <typename KeyOf>
+        index_type find(const KeyT&, hash_type h, KeyOf) const { return slots_[h]; }
+
+        void insert(hash_type h, index_type node) { slots_[h] = node; }
+        void erase(std::uint32_t tag, index_type) { slots_[tag] = npos; }
+
+        void prefetch(hash_type h) const { __builtin_prefetch(&slots_[h]); }
+
+        void clear() { std::fill(slots_.begin(), slots_.end(), npos); }
+
+        // the array already covers every key
+        void reserve(size_type) {}
+
+        size_type universe() const { return slots_.size(); }
+
+    private:
+        // slab_storage keeps the low 32 bits of the hash as the tag erase() gets back
+        static size_type checked_size(key_universe universe) {
+            if (universe.size > (std::uint64_t{1} << 32))
+                throw std::invalid_argument("direct_index keys must fit 32 bits");
+            return universe.size;
+        }
+
+    private:
+        std::vector<index_type> slots_;
+    };
+
+    struct no_node_data {};
+
+    // Keys in one contiguous slab, addressed by 32-bit indices that stay valid
+    // until the node is released. Each node keeps the index tag of its key and
+    // an owner-defined Data payload (list links, say) right next to the key, so
+    // a hit touches a single node. Released nodes are reused first; their tag
+    // field links the free list.
+    template <typename KeyT, typename Data = no_node_data>
+    class slab_storage {
+    public:
+        using key_type = KeyT;
+        using data_type = Data;
+        using size_type = size_t;
+        using index_type = std::uint32_t;
+
+        static constexpr index_type npos = std::numeric_limits<index_type>::max();
+
+        // the same storage with another payload; basic_cache rebinds to its policy's
+        template <typename D>
+        using rebind = slab_storage<KeyT, D>;
+
+    public:
+        explicit slab_storage(size_type capacity = 0) { reserve(capacity); }
+
+        size_type size() const { return size_; }
+
+        // largest index handed out so far, for sizing side arrays
+        size_type slab_size() const { return nodes_.size(); }
+
+        void reserve(size_type capacity) {
+            if (capacity >= npos)
+                throw std::length_error("slab capacity does not fit 32-bit indices");
+            nodes_.reserve(capacity);
+        }
+
+        index_type allocate(const KeyT& key, std::uint32_t tag) {
+            index_type i;
+            if (free_ != npos) {
+                i = free_;
+                free_ = nodes_[i].tag;
+                nodes_[i].key = key;
+                nodes_[i].data = Data{};
+            } else {
+                if (nodes_.size() >= npos)
+                    throw std::length_error("slab capacity does not fit 32-bit indices");
+                i = static_cast<index_type>(nodes_.size());
+                nodes_.push_back(node{key, 0, Data{}});
+            }
+            nodes_[i].tag = tag;
+            size_++;
+            return i;
+        }
+
+        void release(index_type i) {
+            nodes_[i].tag = free_;
+            free_ = i;
+            size_--;
+        }
+
+        void clear() {
+            nodes_.clear();
+            free_ = npos;
+            size_ = 0;
+        }
+
+        const KeyT& key(index_type i) const { return nodes_[i].key; }
+        std::uint32_t tag(index_type i) const { return nodes_[i].tag; }
+        Data& data(index_type i) { return nodes_[i].data; }
+        const Data& data(index_type i) const { return nodes_[i].data; }
+
+        void prefetch(index_type i) const { __builtin_prefetch(&nodes_[i]); }
+
+    private:
+        struct node {
+            KeyT key;
+            std::uint32_t tag;
+            [[no_unique_address]] Data data;
+        };
+
+        size_type size_ = 0;
+        index_type free_ = npos;
+        std::vector<node> nodes_;
+    };
+
+    struct list_links {
+        std::uint32_t prev;
+        std::uint32_t next;
+    };
+
+    // Doubly linked list threaded through the list_links payload of a
+    // slab_storage; it only owns the ends; the storage is passed in.
+    class intrusive_list {
+    public:
+        using index_type = std::uint32_t;
+
+        static constexpr index_type npos = std::numeric_limits<index_type>::max();
+
+    public:
+        index_type front() const { return head_; }
+        index_type back() const { return tail_; }
+
+        template <typename Storage>
+        void link_front(Storage& s, index_type i) {
+            s.data(i).prev = npos;
+            s.data(i).next = head_;
+            if (head_ != npos)
+                s.data(head_).prev = i;
+            else
+                tail_ = i;
+            head_ = i;
+        }
+
+        template <typename Storage>
+        void link_back(Storage& s, index_type i) {
+            s.data(i).next = npos;
+            s.data(i).prev = tail_;
+            if (tail_ != npos)
+                s.data(tail_).next = i;
+            else
+                head_ = i;
+            tail_ = i;
+        }
+
+        template <typename Storage>
+        void unlink(Storage& s, index_type i) {
+            const list_links& n = s.data(i);
+            if (n.prev != npos)
+                s.data(n.prev).next = n.next;
+            else
+                head_ = n.next;
+            if (n.next != npos)
+                s.data(n.next).prev = n.prev;
+            else
+                tail_ = n.prev;
+        }
+
+        template <typename Storage>
+        void move_to_front(Storage& s, index_type i) {
+            if (i == head_)
+                return;
+            unlink(s, i);
+            link_front(s, i);
+        }
+
+        template <typename Storage>
+        void move_to_back(Storage& s, index_type i) {
+            if (i == tail_)
+                return;
+            unlink(s, i);
+            link_back(s, i);
+        }
+
+        void clear() { head_ = tail_ = npos; }
+
+    private:
+        index_type head_ = npos;
+        index_type tail_ = npos;
+    };
+
+    // Doubly linked list of keys living in one preallocated slab: an
+    // intrusive_list over a slab_storage, with lookups through an open_index.
+    // A steady-state cache performs no allocations at all. Indices stay valid
+    // until the node is erased, which lets owners keep per-node data in side
+    // arrays indexed the same way.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class slab_list {
+    public:
+        using size_type = size_t;
+        using index_type = std::uint32_t;
+        using hash_type = typename open_index<KeyT, Hash>::hash_type;
+
+        static constexpr index_type npos = open_index<KeyT, Hash>::npos;
+
+    public:
+        slab_list(size_type capacity) : cap_{capacity}, nodes_{capacity}, index_{capacity} {}
+
+        size_type size() const { return nodes_.size(); }
+        size_type capacity() const { return cap_; }
+        bool empty() const { return size() == 0; }
+        bool full() const { return size() == cap_; }
+
+        hash_type hash(const KeyT& key) const { return index_.hash(key); }
+
+        index_type find(const KeyT& key) const { return find(key, hash(key)); }
+        index_type find(const KeyT& key, hash_type h) const {
+            return index_.find(key, h, [this](index_type i) -> const KeyT& { return nodes_.key(i); });
+        }
+
+        bool contains(const KeyT& key) const { return find(key) != npos; }
+        bool contains(const KeyT& key, hash_type h) const { return find(key, h) != npos; }
+
+        index_type push_front(const KeyT& key) { return push_front(key, hash(key)); }
+        index_type push_front(const KeyT& key, hash_type h) {
+            index_type i = allocate(key, h);
+            order_.link_front(nodes_, i);
+            return i;
+        }
+
+        index_type push_back(const KeyT& key) { return push_back(key, hash(key)); }
+        index_type push_back(const KeyT& key, hash_type h) {
+            index_type i = allocate(key, h);
+            order_.link_back(nodes_, i);
+            return i;
+        }
+
+        void move_to_front(index_type i) { order_.move_to_front(nodes_, i); }
+        void move_to_back(index_type i) { order_.move_to_back(nodes_, i); }
+
+        void erase(index_type i) {
+            order_.unlink(nodes_, i);
+            index_.erase(nodes_.tag(i), i);
+            nodes_.release(i);
+        }
+
+        KeyT pop_back() {
+            KeyT key = nodes_.key(back());
+            erase(back());
+            return key;
+        }
+
+        KeyT pop_front() {
+            KeyT key = nodes_.key(front());
+            erase(front());
+            return key;
+        }
+
+        void clear() {
+            nodes_.clear();
+            index_.clear();
+            order_.clear();
+        }
+
+        // Growing keeps every index valid; shrinking below size() is the caller's job.
+        void set_capacity(size_type capacity) {
+            nodes_.reserve(capacity);
+            index_.reserve(capacity);
+            cap_ = capacity;
+        }
+
+        index_type front() const { return order_.front(); }
+        index_type back() const { return order_.back(); }
+        index_type next(index_type i) const { return nodes_.data(i).next; }
+        index_type prev(index_type i) const { return nodes_.data(i).prev; }
+
+        const KeyT& key(index_type i) const { return nodes_.key(i); }
+
+        // largest index handed out so far, for sizing side arrays
+        size_type slab_size() const { return nodes_.slab_size(); }
+
+        void prefetch(hash_type h) const { index_.prefetch(h); }
+        void prefetch_node(index_type i) const { nodes_.prefetch(i); }
+        // probes the index (best prefetched first) and prefetches the node found
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            if (auto i = find(key, h); i != npos)
+                prefetch_node(i);
+        }
+
+    private:
+        index_type allocate(const KeyT& key, hash_type h) {
+            // the slab and the index are sized once; owners evict before pushing
+            if (size() == cap_)
+                throw std::length_error("slab_list is full");
+
+            index_type i = nodes_.allocate(key, static_cast<std::uint32_t>(h));
+            index_.insert(h, i);
+            return i;
+        }
+
+    private:
+        size_type cap_;
+        slab_storage<KeyT, list_links> nodes_;
+        open_index<KeyT, Hash> index_;
+        intrusive_list order_;
+    };
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "cache.hpp"
+#include "trace.hpp"
+
+// Warm-start snapshots of lru_2_cache. A snapshot is a 48-byte header
+// followed by the keys of the candidate list and then those of the hot list,
+// each from its LRU key to its MRU key, fixed-width and host-endian like the
+// binary traces. Restoring maps the file and makes every key, in file order,
+// the MRU key of its list, which rebuilds both recency orders in one pass.
+// Ghost lists are not saved: an adaptive cache keeps its split but relearns
+// its ghosts.
+namespace caches {
+    namespace snapshot_flags {
+        inline constexpr std::uint32_t adaptive = 1;
+    }
+
+    struct snapshot_header {
+        char magic[4] = {'C', 'S', 'N', 'P'};
+        std::uint16_t version = 1;
+        std::uint16_t key_size = 0;
+        std::uint32_t flags = 0;
+        std::uint32_t reserved = 0;
+        std::uint64_t capacity = 0;
+        std::uint64_t candidate_capacity = 0;
+        std::uint64_t candidates = 0;
+        std::uint64_t hot = 0;
+
+        bool valid() const { return std::memcmp(magic, snapshot_header{}.magic, sizeof(magic)) == 0 && version == 1; }
+    };
+    static_assert(sizeof(snapshot_header) == 48);
+
+    template <typename KeyT, typename Hash, typename Stats>
+    void save_snapshot(const lru_2_cache<KeyT, Hash, Stats>& cache, std::ostream& out) {
+        static_assert(std::is_trivially_copyable_v<KeyT>, "snapshots store keys as raw bytes");
+
+        snapshot_header header;
+        header.key_size = sizeof(KeyT);
+        header.flags = cache.adaptive_split() ? snapshot_flags::adaptive : 0;
+        header.capacity = cache.capacity();
+        header.candidate_capacity = cache.candidate_capacity();
+        header.candidates = cache.queue_size(cache_queue::candidate);
+        header.hot = cache.queue_size(cache_queue::hot);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        std::vector<KeyT> buffer;
+        buffer.reserve(4096);
+        auto write_buffer = [&] {
+            out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size() * sizeof(KeyT)));
+            buffer.clear();
+        };
+        for (auto q : {cache_queue::candidate, cache_queue::hot}) {
+            cache.for_each_by_age(q, [&](const KeyT& key) {
+                buffer.push_back(key);
+                if (buffer.size() == buffer.capacity())
+                    write_buffer();
+            });
+        }
+        write_buffer();
+    }
+
+    // Writes next to path and renames over it, so a crash while saving
+    // leaves the previous snapshot in place.
+    template <typename KeyT, typename Hash, typename Stats>
+    void save_snapshot(const lru_2_cache<KeyT, Hash, Stats>& cache, const std::string& path) {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out)
+                throw std::runtime_error("cannot create " + tmp);
+            save_snapshot(cache, out);
+            out.flush();
+            if (!out)
+                throw std::runtime_error("cannot write " + tmp);
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+            throw std::runtime_error("cannot rename " + tmp + " to " + path);
+    }
+
+    // Replaces the contents of cache with a snapshot and returns the number of
+    // keys read. A cache of another capacity keeps the most recent keys of
+    // each list that fit; an adaptive cache of the same capacity also takes
+    // the saved split. The cache is left untouched if the file is invalid.
+    template <typename KeyT, typename Hash, typename Stats>
+    std::uint64_t restore_snapshot(lru_2_cache<KeyT, Hash, Stats>& cache, const std::string& path) {
+        static_assert(std::is_trivially_copyable_v<KeyT>, "snapshots store keys as raw bytes");
+
+        mapped_file file(path);
+        snapshot_header header;
+        if (file.size() < sizeof(header))
+            throw std::runtime_error(path + " is not a cache snapshot");
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (!header.valid())
+            throw std::runtime_error(path + " is not a cache snapshot");
+        if (header.key_size != sizeof(KeyT))
+            throw std::runtime_error(path + " holds keys of another size");
+        // each count is checked on its own so that their sum cannot wrap
+        std::uint64_t stored = (file.size() - sizeof(header)) / sizeof(KeyT);
+        if (header.candidates > stored || header.hot > stored - header.candidates)
+            throw std::runtime_error(path + " is truncated");
+        std::uint64_t keys = header.candidates + header.hot;
+        if (file.size() != sizeof(header) + keys * sizeof(KeyT))
+            throw std::runtime_error(path + " is truncated");
+
+        cache.clear();
+        if (cache.adaptive_split() && header.capacity == cache.capacity())
+            cache.resize_candidates(header.candidate_capacity);
+
+        const unsigned char* pos = file.data() + sizeof(header);
+        auto replay = [&](cache_queue q, std::uint64_t count) {
+            for (std::uint64_t i = 0; i < count; i++, pos += sizeof(KeyT)) {
+                KeyT key;
+                std::memcpy(&key, pos, sizeof(KeyT));
+                cache.warm(q, key);
+            }
+        };
+        replay(cache_queue::candidate, header.candidates);
+        replay(cache_queue::hot, header.hot);
+        return keys;
+    }
+}
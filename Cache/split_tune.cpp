@@ -0,0 +1,98 @@
+#include "cache.hpp"
+#include "shards.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace caches;
+
+namespace {
+    struct options {
+        double rate = 1.0;
+        size_t points = 10;
+        size_t steps = 20;
+        std::string file;
+    };
+
+    bool parse(int argc, char** argv, options& opts) {
+        int i = 1;
+        for (; i + 1 < argc; i += 2) {
+            std::string flag = argv[i];
+            if (flag == "--rate")
+                opts.rate = std::atof(argv[i + 1]);
+            else if (flag == "--points")
+                opts.points = std::strtoull(argv[i + 1], nullptr, 10);
+            else if (flag == "--steps")
+                opts.steps = std::strtoull(argv[i + 1], nullptr, 10);
+            else
+                break;
+        }
+        if (i < argc)
+            opts.file = argv[i++];
+        return i == argc && opts.points > 0 && opts.steps >= 2 && opts.rate > 0.0 && opts.rate <= 1.0;
+    }
+
+    using sim = shards_sim<lru_2_cache<int>>;
+}
+
+// Finds the candidate/hot split of lru_2_cache with the lowest miss ratio for
+// a trace. One pass feeds a miniature simulation per split (candidate list at
+// 1/steps .. (steps-1)/steps of the capacity) and one with the default 50/50
+// split, at --points capacities up to m. --rate below 1 samples the key space
+// as mrc does, which keeps memory and time proportional to the rate.
+int main(int argc, char** argv) try {
+    options opts;
+    if (!parse(argc, argv, opts)) {
+        std::cerr << "usage: split_tune [--rate R] [--points K] [--steps S] [trace file]\n";
+        return 1;
+    }
+
+    auto requests = opts.file.empty() ? trace::parse(std::cin) : trace::open(opts.file);
+    size_t m = requests.capacity();
+
+    std::vector<size_t> capacities;
+    for (size_t i = 1; i <= opts.points; i++)
+        capacities.push_back(std::max<size_t>(2, m * i / opts.points));
+
+    sim baseline(opts.rate, capacities);
+    std::vector<std::unique_ptr<sim>> splits;
+    for (size_t s = 1; s < opts.steps; s++) {
+        auto make = [s, steps = opts.steps](size_t c) {
+            return std::make_unique<lru_2_cache<int>>(c, c * s / steps);
+        };
+        splits.push_back(std::make_unique<sim>(opts.rate, capacities, 8, make));
+    }
+
+    for (auto q : requests) {
+        int key = int_key(q);
+        baseline.access(key);
+        for (auto& split : splits)
+            split->access(key);
+    }
+
+    std::vector<std::vector<mrc_point>> curves;
+    for (auto& split : splits)
+        curves.push_back(split->curve());
+    auto half = baseline.curve();
+
+    std::cout << "# rate " << baseline.rate() << " sampled " << baseline.sampled() << '\n';
+    std::cout << "# capacity candidates miss_ratio error default_miss_ratio\n";
+    for (size_t i = 0; i < capacities.size(); i++) {
+        size_t best = 0;
+        for (size_t s = 1; s < curves.size(); s++)
+            if (curves[s][i].miss_ratio < curves[best][i].miss_ratio)
+                best = s;
+        const auto& p = curves[best][i];
+        std::cout << p.capacity << ' ' << p.capacity * (best + 1) / opts.steps << ' ' << p.miss_ratio << ' ' << p.error
+                  << ' ' << half[i].miss_ratio << '\n';
+    }
+    return 0;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Statistics policies for the 2Q caches. A cache calls the hooks below from
+// lookup_update; with no_stats (the default) every hook is an empty inline
+// function on an empty member, so the instrumented cache compiles to the same
+// code as before. counting_stats keeps per-queue counters, an optional time
+// series and a sampled latency histogram, and writes them as JSON.
+namespace caches {
+    // lru_2_cache: candidate and hot list. two_q_cache: A1in, Am and A1out.
+    enum class cache_queue : unsigned {
+        candidate = 0,
+        hot = 1,
+        ghost = 2,
+    };
+
+    inline constexpr size_t cache_queue_count = 3;
+
+    inline const char* queue_name(cache_queue q) {
+        constexpr const char* names[cache_queue_count] = {"candidate", "hot", "ghost"};
+        return names[static_cast<unsigned>(q)];
+    }
+
+    struct no_stats {
+        struct scope {};
+
+        scope lookup() { return {}; }
+        void hit(cache_queue) {}
+        void promotion() {}
+        void eviction(cache_queue) {}
+        void admission(cache_queue) {}
+    };
+
+    struct stats_snapshot {
+        std::uint64_t lookups = 0;
+        std::uint64_t promotions = 0;
+        // a ghost "hit" is still a miss for the caller, see hits()
+        std::array<std::uint64_t, cache_queue_count> queue_hits{};
+        std::array<std::uint64_t, cache_queue_count> evictions{};
+        // insertions that found a free slot and evicted nothing
+        std::array<std::uint64_t, cache_queue_count> admissions{};
+
+        std::uint64_t hits() const {
+            return queue_hits[static_cast<unsigned>(cache_queue::candidate)] + queue_hits[static_cast<unsigned>(cache_queue::hot)];
+        }
+
+        void write_json(std::ostream& out) const {
+            out << "{\"lookups\":" << lookups << ",\"hits\":" << hits() << ",\"promotions\":" << promotions << ",\"queues\":{";
+            for (unsigned q = 0; q < cache_queue_count; q++) {
+                out << (q ? "," : "") << '"' << queue_name(static_cast<cache_queue>(q)) << "\":{\"hits\":" << queue_hits[q]
+                    << ",\"evictions\":" << evictions[q] << ",\"admissions\":" << admissions[q] << '}';
+            }
+            out << "}}";
+        }
+    };
+
+    // Power-of-two buckets of nanoseconds: bucket b counts samples in [2^(b-1), 2^b).
+    class latency_histogram {
+    public:
+        static constexpr size_t bucket_count = 40;
+
+        void record(std::uint64_t ns) {
+            size_t b = std::min<size_t>(std::bit_width(ns), bucket_count - 1);
+            buckets_[b]++;
+            samples_++;
+        }
+
+        std::uint64_t samples() const { return samples_; }
+        std::uint64_t bucket(size_t b) const { return buckets_[b]; }
+
+        // upper bound of the bucket holding the q-quantile, 0 without samples
+        std::uint64_t quantile(double q) const {
+            if (samples_ == 0)
+                return 0;
+            auto rank = static_cast<std::uint64_t>(q * static_cast<double>(samples_ - 1));
+            std::uint64_t seen = 0;
+            for (size_t b = 0; b < bucket_count; b++) {
+                seen += buckets_[b];
+                if (seen > rank)
+                    return std::uint64_t{1} << b;
+            }
+            return std::uint64_t{1} << (bucket_count - 1);
+        }
+
+        void write_json(std::ostream& out) const {
+            out << "{\"samples\":" << samples_ << ",\"p50\":" << quantile(0.5) << ",\"p99\":" << quantile(0.99) << ",\"buckets\":[";
+            bool first = true;
+            for (size_t b = 0; b < bucket_count; b++) {
+                if (buckets_[b] == 0)
+                    continue;
+                out << (first ? "" : ",") << "[" << (std::uint64_t{1} << b) << ',' << buckets_[b] << ']';
+                first = false;
+            }
+            out << "]}";
+        }
+
+    private:
+        std::array<std::uint64_t, bucket_count> buckets_{};
+        std::uint64_t samples_ = 0;
+    };
+
+    class counting_stats {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // Ends one lookup: records its latency if it was sampled and appends
+        // to the time series on interval boundaries.
+        class scope {
+        public:
+            scope(counting_stats& owner, bool timed) : owner_{owner}, timed_{timed} {
+                if (timed_)
+                    start_ = clock::now();
+            }
+            scope(const scope&) = delete;
+            scope& operator=(const scope&) = delete;
+
+            ~scope() {
+                if (timed_)
+                    owner_.latency_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start_).count());
+                if (owner_.interval_ && owner_.current_.lookups % owner_.interval_ == 0)
+                    owner_.series_.push_back(owner_.current_);
+            }
+
+        private:
+            counting_stats& owner_;
+            bool timed_;
+            clock::time_point start_;
+        };
+
+    public:
+        // interval: lookups between time series samples, 0 for none.
+        // latency_period: time one lookup out of every latency_period, rounded
+        // up to a power of two; 0 disables timing.
+        explicit counting_stats(std::uint64_t interval = 0, std::uint64_t latency_period = 0) :
+            interval_{interval}, latency_mask_{latency_period ? std::bit_ceil(latency_period) - 1 : 0},
+            timing_{latency_period != 0} {}
+
+        scope lookup() {
+            bool timed = timing_ && (current_.lookups & latency_mask_) == 0;
+            current_.lookups++;
+            return scope(*this, timed);
+        }
+
+        void hit(cache_queue q) { current_.queue_hits[static_cast<unsigned>(q)]++; }
+        void promotion() { current_.promotions++; }
+        void eviction(cache_queue q) { current_.evictions[static_cast<unsigned>(q)]++; }
+        void admission(cache_queue q) { current_.admissions[static_cast<unsigned>(q)]++; }
+
+        const stats_snapshot& snapshot() const { return current_; }
+        const std::vector<stats_snapshot>& series() const { return series_; }
+        const latency_histogram& latency() const { return latency_; }
+
+        void write_json(std::ostream& out) const {
+            out << "{\"totals\":";
+            current_.write_json(out);
+            out << ",\"interval\":" << interval_ << ",\"series\":[";
+            for (size_t i = 0; i < series_.size(); i++) {
+                if (i)
+                    out << ',';
+                series_[i].write_json(out);
+            }
+            out << "],\"latency_ns\":";
+            latency_.write_json(out);
+            out << "}\n";
+        }
+
+    private:
+        std::uint64_t interval_;
+        std::uint64_t latency_mask_;
+        bool timing_;
+        stats_snapshot current_;
+        std::vector<stats_snapshot> series_;
+        latency_histogram latency_;
+    };
+}
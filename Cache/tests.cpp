@@ -3,6 +3,26 @@
 #include "cache.hpp"
 #include "lrucache.hpp"
 #include "perfectcache.hpp"
+#include "slab.hpp"
+#include "heap.hpp"
+#include "shardedcache.hpp"
+#include "twoqueue.hpp"
+#include "arc.hpp"
+#include "s3fifo.hpp"
+#include "lirs.hpp"
+#include "tinylfu.hpp"
+#include "mrc.hpp"
+#include "shards.hpp"
+#include "trace.hpp"
+#include "stats.hpp"
+#include "basic_cache.hpp"
+#include "replay.hpp"
+#include "sizedcache.hpp"
+#include "kvcache.hpp"
+#include "buffered.hpp"
+#include "tiered.hpp"
+#include "snapshot.hpp"
+#include "bench/workloads.hpp"
 
 #include <string>
 #include <vector>
@@ -11,6 +31,16 @@
 #include <random>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <map>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <thread>
+#include <filesystem>
 
 using namespace caches;
 
@@ -202,3 +232,1527 @@ TEST(cache, gen2) {
     ASSERT_TRUE(hits2 >= hits1);
     ASSERT_TRUE(hits3 >= hits2);
 }
+
+TEST(slab, listMatchesStdList) {
+    slab_list<int> slab(64);
+    std::list<int> ref;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 200);
+
+    for (int i = 0; i < 100000; i++) {
+        int key = dist(gen);
+        auto hit = slab.find(key);
+        auto refIt = std::find(ref.begin(), ref.end(), key);
+        ASSERT_EQ(hit != slab.npos, refIt != ref.end());
+
+        if (hit != slab.npos) {
+            if (i % 3 == 0) {
+                slab.erase(hit);
+                ref.erase(refIt);
+            } else {
+                slab.move_to_front(hit);
+                ref.splice(ref.begin(), ref, refIt);
+            }
+            continue;
+        }
+
+        if (slab.full()) {
+            ASSERT_EQ(slab.pop_back(), ref.back());
+            ref.pop_back();
+        }
+        slab.push_front(key);
+        ref.push_front(key);
+    }
+
+    auto it = slab.front();
+    for (int key : ref) {
+        ASSERT_EQ(slab.key(it), key);
+        it = slab.next(it);
+    }
+    ASSERT_EQ(it, slab.npos);
+}
+
+struct collidingHash {
+    size_t operator()(int key) const { return key % 4; }
+};
+
+TEST(slab, collidingKeys) {
+    lru_cache<int, collidingHash> lru(16);
+    for (int key = 0; key < 16; key++)
+        ASSERT_FALSE(lru.lookup_update(key));
+    for (int key = 0; key < 16; key += 2)
+        lru.remove(key);
+    for (int key = 0; key < 16; key++)
+        ASSERT_EQ(lru.isPresent(key), key % 2 == 1);
+}
+
+TEST(slab, zeroCapacity) {
+    lru_cache lru(0);
+    lru_2_cache lru2(1);
+
+    ASSERT_FALSE(lru.lookup_update(1));
+    ASSERT_FALSE(lru.isPresent(1));
+    for (int i = 0; i < 4; i++)
+        lru2.lookup_update(i % 2);
+    ASSERT_TRUE(lru2.full());
+}
+
+TEST(sharded, singleShardMatchesLru2) {
+    std::vector<int> test = genTest(10000);
+    lru_2_cache lru2(20);
+    sharded_lru_2_cache sharded(20, 1);
+    int hits1 = 0, hits2 = 0;
+
+    for (int key : test) {
+        hits1 += lru2.lookup_update(key);
+        hits2 += sharded.lookup_update(key);
+    }
+
+    ASSERT_EQ(hits1, hits2);
+    ASSERT_EQ(sharded.stats().hits, hits2);
+    ASSERT_EQ(sharded.stats().lookups(), test.size());
+}
+
+TEST(sharded, concurrentLookups) {
+    sharded_lru_2_cache sharded(64, 8);
+    std::vector<std::thread> threads;
+    const int perThread = 20000;
+
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&sharded, t] {
+            std::vector<int> test = genTest(perThread);
+            for (int key : test)
+                sharded.lookup_update(key + t);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    auto stats = sharded.stats();
+    ASSERT_EQ(stats.lookups(), 8 * perThread);
+    ASSERT_GT(stats.hits, 0);
+    ASSERT_TRUE(sharded.full());
+}
+
+TEST(twoq, a1inIsFifo) {
+    two_q_cache cache(4);
+    cache.lookup_update(1);
+    cache.lookup_update(2);
+    cache.lookup_update(3);
+    cache.lookup_update(4);
+
+    ASSERT_TRUE(cache.lookup_update(1));
+    cache.lookup_update(5);
+
+    ASSERT_FALSE(cache.isPresent(1));
+    ASSERT_TRUE(cache.isGhost(1));
+}
+
+TEST(twoq, ghostHitGoesToAm) {
+    two_q_cache cache(4);
+    for (int key : {1, 2, 3, 4, 5})
+        cache.lookup_update(key);
+
+    ASSERT_FALSE(cache.lookup_update(1));
+    ASSERT_FALSE(cache.isGhost(1));
+    for (int key : {6, 7, 8, 9, 10})
+        cache.lookup_update(key);
+    ASSERT_TRUE(cache.isPresent(1));
+}
+
+TEST(twoq, scanResistance) {
+    std::vector<int> test;
+    for (int round = 0; round < 2; round++) {
+        for (int key = 0; key < 10; key++)
+            test.push_back(key);
+        for (int key = 100; key < 120; key++)
+            test.push_back(key + round * 20);
+    }
+    for (int key = 1000; key < 2000; key++)
+        test.push_back(key);
+    for (int key = 0; key < 10; key++)
+        test.push_back(key);
+
+    lru_cache lru(20);
+    two_q_cache twoq(20);
+    int hits1 = 0, hits2 = 0;
+    for (int key : test) {
+        hits1 += lru.lookup_update(key);
+        hits2 += twoq.lookup_update(key);
+    }
+
+    ASSERT_EQ(hits1, 0);
+    ASSERT_EQ(hits2, 10);
+}
+
+TEST(twoq, gen) {
+    std::vector<int> test = genTest(1000);
+    two_q_cache twoq(20);
+    perfect_cache perf(20, test.begin(), test.end());
+    int hits1 = 0, hits2 = 0;
+
+    for (int key : test) {
+        hits1 += twoq.lookup_update(key);
+        hits2 += perf.lookup_update(key);
+    }
+
+    ASSERT_TRUE(hits2 >= hits1);
+}
+
+TEST(heap, popsInOrder) {
+    indexed_heap<int> heap;
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> dist(0, 1000);
+    std::vector<int> prio(200);
+
+    for (unsigned slot = 0; slot < prio.size(); slot++) {
+        prio[slot] = dist(gen);
+        heap.push(slot, prio[slot]);
+    }
+    for (unsigned slot = 0; slot < prio.size(); slot += 3) {
+        prio[slot] = dist(gen);
+        heap.update(slot, prio[slot]);
+    }
+    for (unsigned slot = 1; slot < prio.size(); slot += 7) {
+        heap.erase(slot);
+        prio[slot] = -1;
+    }
+
+    int last = 1001;
+    while (!heap.empty()) {
+        auto slot = heap.top();
+        ASSERT_LE(prio[slot], last);
+        ASSERT_EQ(heap.priority(slot), prio[slot]);
+        last = prio[slot];
+        heap.pop();
+    }
+}
+
+// textbook Belady, O(n * capacity) per eviction
+int naiveBelady(const std::vector<int>& test, size_t capacity) {
+    std::vector<int> resident;
+    int hits = 0;
+    for (size_t i = 0; i < test.size(); i++) {
+        if (std::find(resident.begin(), resident.end(), test[i]) != resident.end()) {
+            hits++;
+            continue;
+        }
+        if (resident.size() == capacity) {
+            auto victim = resident.begin();
+            size_t furthest = 0;
+            for (auto it = resident.begin(); it != resident.end(); ++it) {
+                size_t next = std::find(test.begin() + i + 1, test.end(), *it) - test.begin();
+                if (next >= furthest) {
+                    furthest = next;
+                    victim = it;
+                }
+            }
+            resident.erase(victim);
+        }
+        resident.push_back(test[i]);
+    }
+    return hits;
+}
+
+TEST(cache, perfectMatchesNaiveBelady) {
+    for (size_t capacity : {1, 5, 10, 40}) {
+        std::vector<int> test = genTest(2000);
+        perfect_cache perf(capacity, test.begin(), test.end());
+        int hits = 0;
+        for (int key : test)
+            hits += perf.lookup_update(key);
+        ASSERT_EQ(hits, naiveBelady(test, capacity));
+    }
+}
+
+TEST(cache, nextUse) {
+    std::vector<int> test{1, 2, 1, 3, 2, 1};
+    const auto never = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> expected{2, 4, 5, never, never, never};
+
+    ASSERT_EQ(compute_next_use(test.begin(), test.end()), expected);
+
+    std::istringstream input("1 2 1 3 2 1");
+    auto forward = compute_next_use(std::istream_iterator<int>(input), std::istream_iterator<int>());
+    ASSERT_EQ(forward, expected);
+
+    auto wide = compute_next_use<uint64_t>(test.begin(), test.end());
+    ASSERT_EQ(wide[0], 2);
+    ASSERT_EQ(wide[5], std::numeric_limits<uint64_t>::max());
+
+    // 64-bit keys that agree in their low 32 bits stay apart
+    std::vector<std::int64_t> longKeys{1, (std::int64_t{1} << 32) + 1, 1};
+    std::vector<uint32_t> longExpected{2, never, never};
+    ASSERT_EQ(compute_next_use(longKeys.begin(), longKeys.end()), longExpected);
+}
+
+TEST(mrc, matchesLruAtEveryCapacity) {
+    std::vector<int> test = genTest(5000);
+    stack_distance_analyzer analyzer(64);
+    for (int key : test)
+        analyzer.access(key);
+
+    for (size_t capacity : {1, 2, 5, 10, 50, 200, 1000}) {
+        lru_cache lru(capacity);
+        size_t hits = 0;
+        for (int key : test)
+            hits += lru.lookup_update(key);
+        ASSERT_EQ(analyzer.hits(capacity), hits);
+    }
+    ASSERT_EQ(analyzer.hit_curve().back().second + analyzer.cold_misses(), test.size());
+}
+
+TEST(mrc, distances) {
+    stack_distance_analyzer analyzer(2);
+    ASSERT_EQ(analyzer.access(1), analyzer.cold);
+    ASSERT_EQ(analyzer.access(2), analyzer.cold);
+    ASSERT_EQ(analyzer.access(2), 1);
+    ASSERT_EQ(analyzer.access(1), 2);
+    ASSERT_EQ(analyzer.access(3), analyzer.cold);
+    ASSERT_EQ(analyzer.access(2), 3);
+}
+
+TEST(shards, fullRateIsExact) {
+    std::vector<int> test = genTest(5000);
+    auto shards = shards_lru<int>::fixed_rate(1.0);
+    stack_distance_analyzer analyzer;
+    for (int key : test) {
+        shards.access(key);
+        analyzer.access(key);
+    }
+
+    std::vector<size_t> capacities{10, 100, 500};
+    auto curve = shards.curve(capacities);
+    for (size_t i = 0; i < capacities.size(); i++) {
+        double exact = 1.0 - static_cast<double>(analyzer.hits(capacities[i])) / test.size();
+        ASSERT_NEAR(curve[i].miss_ratio, exact, 1e-9);
+    }
+}
+
+std::vector<int> skewedTest(int n, int keys, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::geometric_distribution<int> dist(20.0 / keys);
+    std::vector<int> result;
+    for (int i = 0; i < n; i++)
+        result.push_back(dist(gen) % keys);
+    return result;
+}
+
+TEST(cache, parallelNextUse) {
+    // long enough for 7 chunks; a scan over half the keys leaves many keys
+    // whose only occurrences sit in different chunks
+    std::vector<int> test = skewedTest(400000, 50000, 15);
+    for (int key = 0; key < 200000; key += 2)
+        test.push_back(key);
+    auto expected = compute_next_use(test.begin(), test.end());
+    for (size_t threads : {1, 2, 3, 8, 64}) {
+        auto parallel = compute_next_use_parallel<uint32_t, int>(test, threads);
+        ASSERT_EQ(parallel, expected) << threads << " threads";
+    }
+
+    std::vector<int> small{1, 2, 1, 3, 2, 1};
+    auto parallel = compute_next_use_parallel<uint32_t, int>(small, 4);
+    ASSERT_EQ(parallel, compute_next_use(small.begin(), small.end()));
+}
+
+TEST(shards, sampledWithinError) {
+    std::vector<int> test = skewedTest(300000, 200000, 11);
+    std::vector<size_t> capacities{1000, 5000, 20000};
+
+    auto fixedRate = shards_lru<int>::fixed_rate(0.1);
+    auto fixedSize = shards_lru<int>::fixed_size(4000, 0.5);
+    shards_sim<lru_2_cache<int>> sim(0.1, capacities);
+    stack_distance_analyzer analyzer;
+    for (int key : test) {
+        fixedRate.access(key);
+        fixedSize.access(key);
+        sim.access(key);
+        analyzer.access(key);
+    }
+    ASSERT_LE(fixedSize.sampled_keys(), 4000);
+    ASSERT_LT(fixedSize.rate(), 0.5);
+
+    auto rateCurve = fixedRate.curve(capacities);
+    auto sizeCurve = fixedSize.curve(capacities);
+    auto simCurve = sim.curve();
+    for (size_t i = 0; i < capacities.size(); i++) {
+        double exact = 1.0 - static_cast<double>(analyzer.hits(capacities[i])) / test.size();
+        ASSERT_NEAR(rateCurve[i].miss_ratio, exact, 0.05);
+        ASSERT_NEAR(sizeCurve[i].miss_ratio, exact, 0.05);
+        ASSERT_GT(rateCurve[i].error, 0.0);
+
+        lru_2_cache lru2(capacities[i]);
+        size_t misses = 0;
+        for (int key : test)
+            misses += !lru2.lookup_update(key);
+        ASSERT_NEAR(simCurve[i].miss_ratio, static_cast<double>(misses) / test.size(), 0.05);
+    }
+}
+
+TEST(trace, roundTrip) {
+    std::vector<int64_t> keys{5, -3, 1000000, 7, 7, -2147483648LL, 2147483647};
+    auto path = (std::filesystem::temp_directory_path() / "cache_tests_trace.bin").string();
+
+    for (auto encoding : {trace_encoding::fixed32, trace_encoding::fixed64, trace_encoding::varint_delta}) {
+        {
+            std::ofstream out(path, std::ios::binary);
+            write_trace(out, 42, keys.size(), keys.begin(), keys.end(), encoding);
+        }
+        auto loaded = caches::trace::open(path);
+        ASSERT_EQ(loaded.capacity(), 42);
+        ASSERT_EQ(loaded.size(), keys.size());
+        ASSERT_EQ(loaded.encoding(), encoding);
+        ASSERT_EQ(std::vector<int64_t>(loaded.begin(), loaded.end()), keys);
+    }
+
+    {
+        std::ofstream out(path, std::ios::binary);
+        write_trace(out, 42, keys.size(), keys.begin(), keys.end());
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    auto truncated = caches::trace::open(path);
+    ASSERT_THROW(std::vector<int64_t>(truncated.begin(), truncated.end()), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(trace, text) {
+    std::istringstream input("2 6\n1 2 1\n2 1 2\n");
+    auto loaded = caches::trace::parse(input);
+    ASSERT_EQ(loaded.capacity(), 2);
+
+    lru_cache lru(loaded.capacity());
+    int hits = 0;
+    for (auto key : loaded)
+        hits += lru.lookup_update(static_cast<int>(key));
+    ASSERT_EQ(hits, 4);
+
+    std::istringstream shortInput("2 6\n1 2 1\n");
+    ASSERT_THROW(caches::trace::parse(shortInput), std::runtime_error);
+}
+
+TEST(trace, sized) {
+    std::vector<sized_key> requests{{5, 100}, {-3, 1}, {5, 100}, {1000000, 0}, {7, 4000000000ULL}};
+    auto path = (std::filesystem::temp_directory_path() / "cache_tests_sized.bin").string();
+
+    for (auto encoding : {trace_encoding::fixed32, trace_encoding::fixed64, trace_encoding::varint_delta}) {
+        {
+            std::ofstream out(path, std::ios::binary);
+            write_trace(out, 500, requests.size(), requests.begin(), requests.end(), encoding);
+        }
+        auto loaded = caches::trace::open(path);
+        ASSERT_TRUE(loaded.sized());
+        size_t i = 0;
+        for (auto it = loaded.begin(); it != loaded.end(); ++it, ++i) {
+            ASSERT_EQ(*it, requests[i].key);
+            ASSERT_EQ(it.object_size(), requests[i].size);
+        }
+        ASSERT_EQ(i, requests.size());
+    }
+    std::filesystem::remove(path);
+
+    // sizes are optional per request in text, 1 when missing
+    std::istringstream input("100 3\n1:40 2 1:40\n");
+    auto text = caches::trace::parse(input);
+    ASSERT_TRUE(text.sized());
+    std::vector<std::pair<int64_t, uint64_t>> parsed;
+    for (auto it = text.begin(); it != text.end(); ++it)
+        parsed.emplace_back(*it, it.object_size());
+    ASSERT_EQ(parsed, (std::vector<std::pair<int64_t, uint64_t>>{{1, 40}, {2, 1}, {1, 40}}));
+
+    std::istringstream plain("2 2\n1 2\n");
+    auto unsized = caches::trace::parse(plain);
+    ASSERT_FALSE(unsized.sized());
+    ASSERT_EQ(unsized.begin().object_size(), 1);
+}
+
+TEST(arc, secondHitPromotes) {
+    arc_cache arc(4);
+    for (int key : {1, 2, 3, 4})
+        ASSERT_FALSE(arc.lookup_update(key));
+    ASSERT_TRUE(arc.lookup_update(1));
+    ASSERT_TRUE(arc.full());
+
+    // 1 lives in T2 now, so a run of new keys evicts from T1 first
+    for (int key : {5, 6, 7})
+        arc.lookup_update(key);
+    ASSERT_TRUE(arc.isPresent(1));
+    ASSERT_FALSE(arc.isPresent(2));
+}
+
+TEST(arc, ghostHitGrowsTarget) {
+    arc_cache arc(4);
+    for (int key : {1, 2, 3, 4, 1, 2, 5, 6})
+        arc.lookup_update(key);
+    ASSERT_EQ(arc.target(), 0);
+
+    // 3 was evicted from T1 into B1: T1 should have been larger
+    ASSERT_FALSE(arc.lookup_update(3));
+    ASSERT_GT(arc.target(), 0);
+    ASSERT_TRUE(arc.isPresent(3));
+}
+
+TEST(arc, frequentKeysSurviveScan) {
+    std::vector<int> test;
+    for (int round = 0; round < 2; round++)
+        for (int key = 0; key < 5; key++)
+            test.push_back(key);
+    for (int key = 100; key < 200; key++)
+        test.push_back(key);
+    for (int key = 0; key < 5; key++)
+        test.push_back(key);
+
+    lru_cache lru(10);
+    arc_cache arc(10);
+    int hits1 = 0, hits2 = 0;
+    for (int key : test) {
+        hits1 += lru.lookup_update(key);
+        hits2 += arc.lookup_update(key);
+    }
+
+    ASSERT_EQ(hits1, 5);
+    ASSERT_EQ(hits2, 10);
+}
+
+TEST(arc, gen) {
+    std::vector<int> test = genTest(1000);
+    arc_cache arc(20);
+    perfect_cache perf(20, test.begin(), test.end());
+    int hits1 = 0, hits2 = 0;
+
+    for (int key : test) {
+        hits1 += arc.lookup_update(key);
+        hits2 += perf.lookup_update(key);
+    }
+
+    ASSERT_TRUE(hits2 >= hits1);
+    ASSERT_TRUE(arc.full());
+}
+
+TEST(s3fifo, unusedKeysLeaveThroughSmall) {
+    // one slot for small, nine for main
+    s3fifo_cache cache(10);
+    for (int key = 0; key < 10; key++)
+        cache.lookup_update(key);
+    for (int key = 0; key < 5; key++)
+        ASSERT_TRUE(cache.lookup_update(key));
+    ASSERT_EQ(cache.small_size(), 10);
+
+    // hit keys move to main as they reach the tail, the others become ghosts
+    for (int key = 100; key < 105; key++)
+        cache.lookup_update(key);
+    for (int key = 0; key < 5; key++)
+        ASSERT_TRUE(cache.isMain(key));
+    for (int key = 5; key < 10; key++)
+        ASSERT_FALSE(cache.isPresent(key));
+    ASSERT_EQ(cache.ghost_size(), 5);
+    ASSERT_EQ(cache.main_size(), 5);
+
+    // a ghost comes back straight into main; small still has its share, so
+    // its oldest key makes room and becomes a ghost in turn
+    ASSERT_FALSE(cache.lookup_update(5));
+    ASSERT_TRUE(cache.isMain(5));
+    ASSERT_FALSE(cache.isPresent(100));
+    ASSERT_EQ(cache.ghost_size(), 5);
+}
+
+TEST(s3fifo, lazyPromotionInMain) {
+    s3fifo_cache cache(10);
+    for (int key = 0; key < 10; key++)
+        cache.lookup_update(key);
+    for (int key = 0; key < 9; key++)
+        cache.lookup_update(key);
+    // 0..8 go to main, 9 becomes a ghost, 100 takes its slot
+    cache.lookup_update(100);
+    ASSERT_EQ(cache.main_size(), 9);
+
+    // 100 is hit, so the next eviction moves it to main and main, now over
+    // its share, evicts: its tail 0 was hit since the move and is reinserted
+    // at the head, 1 was not and leaves
+    cache.lookup_update(0);
+    cache.lookup_update(100);
+    cache.lookup_update(200);
+    ASSERT_TRUE(cache.isMain(0) && cache.isMain(100));
+    ASSERT_FALSE(cache.isPresent(1));
+    ASSERT_TRUE(cache.isPresent(2));
+}
+
+TEST(s3fifo, frequentKeysSurviveScan) {
+    std::vector<int> test;
+    for (int round = 0; round < 2; round++)
+        for (int key = 0; key < 5; key++)
+            test.push_back(key);
+    for (int key = 100; key < 200; key++)
+        test.push_back(key);
+    for (int key = 0; key < 5; key++)
+        test.push_back(key);
+
+    s3fifo_cache cache(10);
+    int hits = 0;
+    for (int key : test)
+        hits += cache.lookup_update(key);
+    ASSERT_EQ(hits, 10);
+}
+
+TEST(s3fifo, gen) {
+    std::vector<int> test = genTest(1000);
+    s3fifo_cache cache(20);
+    perfect_cache perf(20, test.begin(), test.end());
+    int hits1 = 0, hits2 = 0;
+    for (int key : test) {
+        hits1 += cache.lookup_update(key);
+        hits2 += perf.lookup_update(key);
+    }
+    ASSERT_GE(hits2, hits1);
+    ASSERT_TRUE(cache.full());
+    ASSERT_EQ(cache.small_size() + cache.main_size(), 20);
+}
+
+TEST(lirs, reusedHirKeyBecomesLir) {
+    // nine LIR slots and one for resident HIR keys
+    lirs_cache cache(10);
+    for (int key = 0; key < 11; key++)
+        cache.lookup_update(key);
+    for (int key = 0; key < 9; key++)
+        ASSERT_TRUE(cache.isLir(key));
+    // 9 was evicted for 10 but stays in the stack
+    ASSERT_FALSE(cache.isPresent(9));
+    ASSERT_EQ(cache.nonresident_size(), 1);
+
+    // its reuse distance beats the oldest LIR key 0, which is demoted, and
+    // 10 is evicted to make room
+    ASSERT_FALSE(cache.lookup_update(9));
+    ASSERT_TRUE(cache.isLir(9));
+    ASSERT_TRUE(cache.isPresent(0));
+    ASSERT_FALSE(cache.isLir(0));
+    ASSERT_FALSE(cache.isPresent(10));
+    ASSERT_EQ(cache.lir_size(), 9);
+    ASSERT_EQ(cache.hir_size(), 1);
+
+    // a resident HIR key out of the stack stays HIR on a hit
+    ASSERT_TRUE(cache.lookup_update(0));
+    ASSERT_FALSE(cache.isLir(0));
+
+    // touching every LIR key from the bottom up prunes the non-resident 10
+    for (int key = 1; key < 9; key++)
+        ASSERT_TRUE(cache.lookup_update(key));
+    ASSERT_EQ(cache.nonresident_size(), 0);
+}
+
+TEST(lirs, loopLargerThanCache) {
+    // LRU misses on every request of a loop over 110 keys with 100 slots
+    std::vector<int> test;
+    for (int round = 0; round < 20; round++)
+        for (int key = 0; key < 110; key++)
+            test.push_back(key);
+
+    lirs_cache cache(100);
+    lru_cache<int> lru(100);
+    perfect_cache perf(100, test.begin(), test.end());
+    int hits = 0, lru_hits = 0, perf_hits = 0;
+    for (int key : test) {
+        hits += cache.lookup_update(key);
+        lru_hits += lru.lookup_update(key);
+        perf_hits += perf.lookup_update(key);
+    }
+    ASSERT_EQ(lru_hits, 0);
+    // the LIR set keeps 99 keys of the loop from the second round on
+    ASSERT_GE(hits, 19 * 99);
+    ASSERT_GE(perf_hits, hits);
+}
+
+TEST(lirs, capacityOne) {
+    // no LIR set: the one slot holds the last key, as in any policy
+    lirs_cache cache(1);
+    ASSERT_FALSE(cache.lookup_update(1));
+    ASSERT_FALSE(cache.lookup_update(2));
+    ASSERT_TRUE(cache.lookup_update(2));
+    ASSERT_TRUE(cache.isPresent(2));
+    ASSERT_FALSE(cache.isPresent(1));
+    ASSERT_EQ(cache.size(), 1);
+    ASSERT_FALSE(cache.lookup_update(1));
+
+    lru_cache<int> lru(1);
+    for (int key : skewedTest(5000, 40, 16))
+        ASSERT_EQ(cache.lookup_update(key), lru.lookup_update(key));
+    ASSERT_EQ(cache.lir_size(), 0);
+    ASSERT_LE(cache.nonresident_size(), 1);
+}
+
+TEST(lirs, gen) {
+    std::vector<int> test = genTest(1000);
+    lirs_cache cache(20);
+    perfect_cache perf(20, test.begin(), test.end());
+    int hits1 = 0, hits2 = 0;
+    for (int key : test) {
+        hits1 += cache.lookup_update(key);
+        hits2 += perf.lookup_update(key);
+    }
+    ASSERT_GE(hits2, hits1);
+    ASSERT_TRUE(cache.full());
+    ASSERT_LE(cache.lir_size(), 19);
+    ASSERT_LE(cache.nonresident_size(), 20);
+}
+
+TEST(tinylfu, sketchCountsFrequency) {
+    frequency_sketch<int> sketch(64);
+    for (int i = 0; i < 8; i++)
+        sketch.increment(1);
+    sketch.increment(2);
+
+    ASSERT_GE(sketch.estimate(1), 8u);
+    ASSERT_LE(sketch.estimate(2), 1u);
+    ASSERT_EQ(sketch.estimate(3), 0u);
+}
+
+TEST(tinylfu, sketchAges) {
+    frequency_sketch<int> sketch(4);
+    for (int i = 0; i < 15; i++)
+        sketch.increment(1);
+    unsigned before = sketch.estimate(1);
+
+    // sample size is 40 increments; a stream of other keys triggers the reset
+    for (int key = 100; key < 140; key++)
+        sketch.increment(key);
+    ASSERT_LT(sketch.estimate(1), before);
+}
+
+TEST(tinylfu, rejectsOneHitWonders) {
+    tinylfu_cache cache(100);
+    for (int round = 0; round < 8; round++)
+        for (int key = 0; key < 100; key++)
+            cache.lookup_update(key);
+    ASSERT_TRUE(cache.full());
+
+    // a scan of new keys only churns the window
+    for (int key = 1000; key < 1500; key++)
+        cache.lookup_update(key);
+    int hits = 0;
+    for (int key = 0; key < 100; key++)
+        hits += cache.lookup_update(key);
+    ASSERT_GE(hits, 95);
+}
+
+TEST(tinylfu, zipfBeatsLru) {
+    std::vector<int> test = workloads::zipf(200000, 20000, 0.8, 7);
+
+    lru_cache lru(500);
+    lru_2_cache lru2(500);
+    tinylfu_cache tinylfu(500);
+    perfect_cache perf(500, test.begin(), test.end());
+    int hits1 = 0, hits2 = 0, hits3 = 0, hits4 = 0;
+    for (int key : test) {
+        hits1 += lru.lookup_update(key);
+        hits2 += lru2.lookup_update(key);
+        hits3 += tinylfu.lookup_update(key);
+        hits4 += perf.lookup_update(key);
+    }
+
+    ASSERT_GT(hits3, hits1);
+    ASSERT_GT(hits3, hits2);
+    ASSERT_GE(hits4, hits3);
+}
+
+TEST(tinylfu, gen) {
+    std::vector<int> test = genTest(1000);
+    tinylfu_cache cache(20);
+    perfect_cache perf(20, test.begin(), test.end());
+    int hits1 = 0, hits2 = 0;
+
+    for (int key : test) {
+        hits1 += cache.lookup_update(key);
+        hits2 += perf.lookup_update(key);
+    }
+
+    ASSERT_TRUE(hits2 >= hits1);
+}
+
+TEST(tinylfu, tinyCapacities) {
+    // (2 - 1) * 4 / 5 leaves no protected segment: probation hits stay there
+    tinylfu_cache cache2(2);
+    cache2.lookup_update(1);
+    cache2.lookup_update(2);
+    ASSERT_TRUE(cache2.lookup_update(1));
+
+    std::vector<int> test = skewedTest(2000, 40, 3);
+    for (size_t capacity = 0; capacity <= 5; capacity++) {
+        tinylfu_cache cache(capacity);
+        perfect_cache perf(capacity, test.begin(), test.end());
+        int hits1 = 0, hits2 = 0;
+        for (int key : test) {
+            hits1 += cache.lookup_update(key);
+            hits2 += perf.lookup_update(key);
+        }
+        ASSERT_GE(hits2, hits1);
+        ASSERT_TRUE(cache.full());
+    }
+}
+
+TEST(sized, lruEvictsBytes) {
+    sized_lru_cache<int> lru(10);
+    ASSERT_FALSE(lru.lookup_update_sized(1, 4));
+    ASSERT_FALSE(lru.lookup_update_sized(2, 4));
+    ASSERT_TRUE(lru.lookup_update_sized(1, 4));
+    ASSERT_FALSE(lru.lookup_update_sized(3, 4));
+    ASSERT_FALSE(lru.isPresent(2));
+    ASSERT_EQ(lru.used(), 8);
+
+    // larger than the whole cache: never admitted, nothing evicted
+    ASSERT_FALSE(lru.lookup_update_sized(4, 11));
+    ASSERT_FALSE(lru.isPresent(4));
+    ASSERT_EQ(lru.size(), 2);
+}
+
+TEST(sized, gdsfEvictsLargeBeforeSmall) {
+    gdsf_cache<int> gdsf(100);
+    sized_lru_cache<int> lru(100);
+    for (int key = 1; key <= 4; key++) {
+        gdsf.lookup_update_sized(key, 10);
+        lru.lookup_update_sized(key, 10);
+    }
+    gdsf.lookup_update_sized(99, 60);
+    lru.lookup_update_sized(99, 60);
+
+    gdsf.lookup_update_sized(5, 10);
+    lru.lookup_update_sized(5, 10);
+    ASSERT_FALSE(gdsf.isPresent(99));
+    ASSERT_TRUE(gdsf.isPresent(1));
+    ASSERT_TRUE(lru.isPresent(99));
+    ASSERT_FALSE(lru.isPresent(1));
+    ASSERT_DOUBLE_EQ(gdsf.inflation(), 1.0 / 60);
+    ASSERT_EQ(gdsf.used(), 50);
+}
+
+TEST(sized, gdsfFrequencyOutweighsSize) {
+    gdsf_cache<int> gdsf(30);
+    // 1 costs 3 times the bytes of 2 and 3 but is requested 4 times as often
+    for (int i = 0; i < 4; i++)
+        gdsf.lookup_update_sized(1, 15);
+    gdsf.lookup_update_sized(2, 5);
+    gdsf.lookup_update_sized(3, 5);
+    gdsf.lookup_update_sized(3, 5);
+    gdsf.lookup_update_sized(4, 10);
+    ASSERT_TRUE(gdsf.isPresent(1));
+    ASSERT_FALSE(gdsf.isPresent(2));
+}
+
+TEST(sized, perfectBound) {
+    std::vector<int> keys = skewedTest(20000, 2000, 6);
+
+    // with unit sizes it is Belady's free to bypass, at least perfect_cache's hits
+    for (size_t c : {10, 100, 500}) {
+        perfect_cache<int> perfect(c, keys.begin(), keys.end());
+        sized_perfect_cache<int> sized(c, keys.begin(), keys.end());
+        size_t expected = 0, hits = 0;
+        for (int key : keys) {
+            expected += perfect.lookup_update(key);
+            hits += sized.lookup_update(key);
+        }
+        ASSERT_GE(hits, expected);
+    }
+
+    std::mt19937 gen(3);
+    std::vector<uint64_t> sizes(2000);
+    for (auto& s : sizes)
+        s = 1 + gen() % 100;
+    for (uint64_t c : {500, 5000, 20000}) {
+        sized_perfect_cache<int> perfect(c, keys.begin(), keys.end());
+        gdsf_cache<int> gdsf(c);
+        sized_lru_cache<int> lru(c);
+        size_t perfectHits = 0, gdsfHits = 0, lruHits = 0;
+        for (int key : keys) {
+            perfectHits += perfect.lookup_update_sized(key, sizes[key]);
+            gdsfHits += gdsf.lookup_update_sized(key, sizes[key]);
+            lruHits += lru.lookup_update_sized(key, sizes[key]);
+            ASSERT_LE(perfect.used(), c);
+            ASSERT_LE(gdsf.used(), c);
+        }
+        ASSERT_GE(perfectHits, gdsfHits);
+        ASSERT_GT(gdsfHits, lruHits);
+    }
+}
+
+TEST(stats, disabledIsFree) {
+    static_assert(sizeof(lru_2_cache<int>) == sizeof(lru_2_cache<int, std::hash<int>, counting_stats>) - sizeof(counting_stats));
+    static_assert(std::is_empty_v<no_stats>);
+}
+
+TEST(stats, lru2Queues) {
+    lru_2_cache<int, std::hash<int>, counting_stats> cache(4);
+    // 1, 2 fill the candidates, 3, 4 the hot list
+    for (int key : {1, 2, 3, 4})
+        cache.lookup_update(key);
+    cache.lookup_update(1); // candidate hit, promoted: evicts 3 from hot
+    cache.lookup_update(1); // hot hit
+    cache.lookup_update(5); // evicts 2 from the candidates
+
+    const auto& s = cache.stats().snapshot();
+    ASSERT_EQ(s.lookups, 7);
+    ASSERT_EQ(s.hits(), 2);
+    ASSERT_EQ(s.queue_hits[0], 1);
+    ASSERT_EQ(s.queue_hits[1], 1);
+    ASSERT_EQ(s.promotions, 1);
+    ASSERT_EQ(s.admissions[0], 2);
+    ASSERT_EQ(s.admissions[1], 2);
+    ASSERT_EQ(s.evictions[0], 1);
+    ASSERT_EQ(s.evictions[1], 1);
+}
+
+TEST(stats, twoqQueuesMatchHits) {
+    std::vector<int> test = skewedTest(20000, 500, 3);
+    two_q_cache<int, std::hash<int>, counting_stats> cache(50, 0.25, 0.5, counting_stats(1000, 16));
+    two_q_cache plain(50);
+    std::uint64_t hits = 0, misses = 0;
+    for (int key : test) {
+        bool hit = cache.lookup_update(key);
+        ASSERT_EQ(hit, plain.lookup_update(key));
+        hits += hit;
+        misses += !hit;
+    }
+
+    const auto& s = cache.stats().snapshot();
+    ASSERT_EQ(s.lookups, test.size());
+    ASSERT_EQ(s.hits(), hits);
+    // every miss inserts: either into a free slot or after an eviction from A1in or Am
+    ASSERT_EQ(misses, s.admissions[0] + s.admissions[1] + s.evictions[0] + s.evictions[1]);
+    ASSERT_EQ(s.promotions, s.queue_hits[2]);
+    ASSERT_EQ(cache.stats().series().size(), 20);
+    ASSERT_EQ(cache.stats().series()[9].lookups, 10000);
+    ASSERT_EQ(cache.stats().latency().samples(), 20000 / 16);
+
+    std::ostringstream json;
+    cache.stats().write_json(json);
+    ASSERT_TRUE(json.str().starts_with("{\"totals\":{\"lookups\":20000,"));
+    ASSERT_NE(json.str().find("\"ghost\":{\"hits\":" + std::to_string(s.queue_hits[2])), std::string::npos);
+}
+
+TEST(cache, lruResize) {
+    lru_cache cache(4);
+    for (int key : {1, 2, 3, 4})
+        cache.lookup_update(key);
+    cache.resize(2);
+    ASSERT_EQ(cache.size(), 2);
+    ASSERT_TRUE(cache.full());
+    ASSERT_TRUE(cache.isPresent(3) && cache.isPresent(4));
+    ASSERT_EQ(cache.lru_key(), 3);
+
+    cache.resize(3);
+    ASSERT_FALSE(cache.lookup_update(5));
+    ASSERT_TRUE(cache.full());
+    ASSERT_TRUE(cache.isPresent(3));
+}
+
+TEST(cache, fixedSplit) {
+    lru_2_cache<int> cache(10, 2);
+    ASSERT_EQ(cache.candidate_capacity(), 2);
+    // 0 and 1 take the candidate slots, 2..9 the free hot ones
+    for (int key = 0; key < 10; key++)
+        cache.lookup_update(key);
+    for (int key : {10, 11, 12})
+        cache.lookup_update(key);
+    ASSERT_FALSE(cache.isPresent(10));
+    ASSERT_TRUE(cache.isPresent(11) && cache.isPresent(12) && cache.isPresent(2));
+    ASSERT_EQ(lru_2_cache<int>(10).candidate_capacity(), 5);
+}
+
+TEST(cache, adaptiveSplitFollowsGhosts) {
+    adaptive_lru_2_cache<int> cache(10);
+    ASSERT_EQ(cache.candidate_capacity(), 5);
+
+    // 100..104 end up hot, then a loop over 7 keys only fits a candidate
+    // list larger than 5; its candidate ghost hits should grow the list
+    std::vector<int> test;
+    for (int key = 100; key < 110; key++)
+        test.push_back(key);
+    for (int key = 100; key < 105; key++)
+        test.push_back(key);
+    for (int round = 0; round < 50; round++)
+        for (int key = 0; key < 7; key++)
+            test.push_back(key);
+    lru_2_cache fixed(10);
+    int hits1 = 0, hits2 = 0;
+    for (int key : test) {
+        hits1 += fixed.lookup_update(key);
+        hits2 += cache.lookup_update(key);
+    }
+    ASSERT_GT(cache.candidate_capacity(), 5);
+    ASSERT_LT(cache.candidate_capacity(), 10);
+    ASSERT_EQ(hits1, 5);
+    ASSERT_GT(hits2, 250);
+}
+
+TEST(shards, simWithFactory) {
+    std::vector<int> test = skewedTest(20000, 2000, 5);
+    std::vector<size_t> capacities{100, 400};
+    shards_sim<lru_2_cache<int>> half(1.0, capacities);
+    shards_sim<lru_2_cache<int>> split(1.0, capacities, 8, [](size_t c) { return std::make_unique<lru_2_cache<int>>(c, c / 2); });
+    for (int key : test) {
+        half.access(key);
+        split.access(key);
+    }
+    auto a = half.curve(), b = split.curve();
+    for (size_t i = 0; i < capacities.size(); i++)
+        ASSERT_EQ(a[i].miss_ratio, b[i].miss_ratio);
+}
+
+template <typename Cache, typename... Args>
+void checkBatch(const std::vector<int>& test, size_t batch, Args... args) {
+    Cache scalar(args...), batched(args...);
+    std::vector<bool> expected;
+    for (int key : test)
+        expected.push_back(scalar.lookup_update(key));
+
+    std::unique_ptr<bool[]> hits(new bool[test.size()]);
+    size_t total = 0;
+    for (size_t i = 0; i < test.size(); i += batch) {
+        size_t n = std::min(batch, test.size() - i);
+        total += batched.lookup_update_batch(std::span<const int>(test.data() + i, n), std::span<bool>(hits.get() + i, n));
+    }
+
+    ASSERT_EQ(total, static_cast<size_t>(std::count(expected.begin(), expected.end(), true)));
+    for (size_t i = 0; i < test.size(); i++)
+        ASSERT_EQ(hits[i], expected[i]) << "request " << i;
+}
+
+TEST(batch, matchesScalar) {
+    std::vector<int> test = skewedTest(20000, 3000, 9);
+    for (size_t batch : {1, 7, 64, 250}) {
+        checkBatch<lru_cache<int>>(test, batch, 200);
+        checkBatch<fifo_cache<int>>(test, batch, 200);
+        checkBatch<lru_2_cache<int>>(test, batch, 200);
+        checkBatch<adaptive_lru_2_cache<int>>(test, batch, 200);
+        checkBatch<two_q_cache<int>>(test, batch, 200);
+        checkBatch<arc_cache<int>>(test, batch, 200);
+        checkBatch<s3fifo_cache<int>>(test, batch, 200);
+        checkBatch<lirs_cache<int>>(test, batch, 200);
+        checkBatch<tinylfu_cache<int>>(test, batch, 200);
+        checkBatch<gdsf_cache<int>>(test, batch, 200);
+        checkBatch<sized_lru_cache<int>>(test, batch, 200);
+        checkBatch<dense_cache<int>>(test, batch, 200, key_universe{3000});
+        checkBatch<perfect_cache<int>>(test, batch, 200, test.begin(), test.end());
+        checkBatch<sharded_lru_2_cache<int>>(test, batch, 200, 4);
+    }
+}
+
+TEST(batch, hitsOptional) {
+    std::vector<int> test = skewedTest(1000, 100, 2);
+    lru_cache<int> scalar(20), batched(20);
+    size_t expected = 0;
+    for (int key : test)
+        expected += scalar.lookup_update(key);
+    ASSERT_EQ(batched.lookup_update_batch(test), expected);
+
+    bool hits[3];
+    ASSERT_THROW(batched.lookup_update_batch(std::span<const int>(test.data(), 4), hits), std::invalid_argument);
+}
+
+// evicts the most recently used key: a policy written against basic_cache alone
+class mru_policy : public lru_policy {
+public:
+    template <typename Storage>
+    index_type victim(const Storage&) const { return order_.front(); }
+};
+
+TEST(basic, fifoIgnoresHits) {
+    fifo_cache cache(3);
+    for (int key : {1, 2, 3, 1})
+        cache.lookup_update(key);
+    cache.lookup_update(4);
+    // 1 is the oldest insertion even though it was hit last
+    ASSERT_FALSE(cache.isPresent(1));
+    ASSERT_TRUE(cache.isPresent(2) && cache.isPresent(3) && cache.isPresent(4));
+}
+
+TEST(basic, customPolicy) {
+    basic_cache<mru_policy> cache(3);
+    for (int key : {1, 2, 3, 4})
+        cache.lookup_update(key);
+    ASSERT_FALSE(cache.isPresent(3));
+    ASSERT_TRUE(cache.full());
+    ASSERT_EQ(cache.victim_key(), 4);
+}
+
+TEST(basic, removeAndResize) {
+    basic_cache<lru_policy, slab_storage<std::int64_t>> cache(4);
+    for (std::int64_t key : {1ll << 40, 2ll << 40, 3ll << 40, 4ll << 40})
+        cache.lookup_update(key);
+    cache.remove(2ll << 40);
+    cache.remove(5ll << 40);
+    ASSERT_EQ(cache.size(), 3);
+    ASSERT_FALSE(cache.isPresent(2ll << 40));
+
+    cache.resize(2);
+    ASSERT_EQ(cache.size(), 2);
+    ASSERT_TRUE(cache.isPresent(3ll << 40) && cache.isPresent(4ll << 40));
+
+    std::vector<std::int64_t> keys;
+    cache.for_each([&](std::int64_t key, auto) { keys.push_back(key); });
+    std::sort(keys.begin(), keys.end());
+    ASSERT_EQ(keys, (std::vector<std::int64_t>{3ll << 40, 4ll << 40}));
+}
+
+TEST(basic, statsUnderHot) {
+    basic_cache<lru_policy, slab_storage<int>, open_index<int>, counting_stats> cache(2);
+    for (int key : {1, 2, 1, 3})
+        cache.lookup_update(key);
+    const auto& s = cache.stats().snapshot();
+    ASSERT_EQ(s.lookups, 4);
+    ASSERT_EQ(s.hits(), 1);
+    ASSERT_EQ(s.admissions[1], 2);
+    ASSERT_EQ(s.evictions[1], 1);
+}
+
+TEST(replay, matchesDirectRuns) {
+    std::vector<int> test = skewedTest(20000, 2000, 4);
+    replay_trace shared(test);
+    std::vector<replay_config> configs;
+    for (const auto& entry : policy_registry()) {
+        for (size_t capacity : {10, 100, 400})
+            configs.push_back({std::string(entry.name), capacity});
+    }
+
+    auto results = replay_all(shared, configs, 4);
+    ASSERT_EQ(results.size(), configs.size());
+    for (size_t i = 0; i < configs.size(); i++) {
+        ASSERT_EQ(results[i].config.policy, configs[i].policy);
+        ASSERT_EQ(results[i].config.capacity, configs[i].capacity);
+    }
+
+    auto direct = [&](auto cache) {
+        size_t hits = 0;
+        for (int key : test)
+            hits += cache.lookup_update(key);
+        return hits;
+    };
+    // every registered policy against a key-at-a-time run of the same cache
+    std::map<std::string, std::function<size_t(size_t)>, std::less<>> runs = {
+        {"lru", [&](size_t c) { return direct(lru_cache<int>(c)); }},
+        {"fifo", [&](size_t c) { return direct(fifo_cache<int>(c)); }},
+        {"slru", [&](size_t c) { return direct(slru_cache<int>(c)); }},
+        {"lru2", [&](size_t c) { return direct(lru_2_cache<int>(c)); }},
+        {"lru2-adaptive", [&](size_t c) { return direct(adaptive_lru_2_cache<int>(c)); }},
+        {"2q", [&](size_t c) { return direct(two_q_cache<int>(c)); }},
+        {"arc", [&](size_t c) { return direct(arc_cache<int>(c)); }},
+        {"s3fifo", [&](size_t c) { return direct(s3fifo_cache<int>(c)); }},
+        {"lirs", [&](size_t c) { return direct(lirs_cache<int>(c)); }},
+        {"tinylfu", [&](size_t c) { return direct(tinylfu_cache<int>(c)); }},
+        {"gdsf", [&](size_t c) { return direct(gdsf_cache<int>(c)); }},
+        {"perfect", [&](size_t c) { return direct(perfect_cache<int>(c, test.begin(), test.end())); }},
+    };
+    for (const auto& r : results) {
+        auto run = runs.find(r.config.policy);
+        ASSERT_NE(run, runs.end()) << "no direct run for " << r.config.policy;
+        ASSERT_EQ(r.hits, run->second(r.config.capacity)) << r.config.policy << '/' << r.config.capacity;
+    }
+}
+
+TEST(replay, unknownPolicy) {
+    replay_trace shared({1, 2, 3});
+    ASSERT_THROW(replay_all(shared, {{"lru", 1}, {"nope", 1}}, 2), std::invalid_argument);
+    ASSERT_EQ(find_policy("nope"), nullptr);
+}
+
+TEST(kv, loadsOnMissOnly) {
+    kv_cache<int, std::string> kv(2);
+    int loads = 0;
+    auto loader = [&](int key) {
+        loads++;
+        return std::to_string(key);
+    };
+    ASSERT_EQ(kv.get_or_load(1, loader), "1");
+    ASSERT_EQ(kv.get_or_load(2, loader), "2");
+    ASSERT_EQ(kv.get_or_load(1, loader), "1");
+    ASSERT_EQ(loads, 2);
+
+    // 2 is the least recently used
+    ASSERT_EQ(kv.get_or_load(3, loader), "3");
+    ASSERT_FALSE(kv.isPresent(2));
+    ASSERT_EQ(kv.get(2), nullptr);
+    ASSERT_EQ(*kv.get(1), "1");
+
+    // a throwing loader leaves the cache untouched
+    ASSERT_THROW(kv.get_or_load(4, [](int) -> std::string { throw std::runtime_error("down"); }), std::runtime_error);
+    ASSERT_TRUE(kv.isPresent(1));
+    ASSERT_TRUE(kv.isPresent(3));
+    ASSERT_EQ(kv.size(), 2);
+}
+
+TEST(kv, batchedWriteBack) {
+    std::vector<std::vector<std::pair<int, bool>>> batches;
+    kv_cache<int, std::unique_ptr<int>> kv(2, [&](std::span<evicted_entry<int, std::unique_ptr<int>>> evicted) {
+        auto& batch = batches.emplace_back();
+        for (auto& e : evicted) {
+            ASSERT_EQ(*e.value, e.key * 10);
+            batch.emplace_back(e.key, e.dirty);
+        }
+    }, 3);
+
+    auto load = [](int key) { return std::make_unique<int>(key * 10); };
+    kv.get_or_load(1, load);
+    kv.put(2, std::make_unique<int>(20));
+    kv.get_or_load(3, load);
+    kv.get_or_load(4, load);
+    ASSERT_TRUE(batches.empty());
+    ASSERT_EQ(kv.pending_evictions(), 2);
+    **kv.get(4) = 40;
+    kv.mark_dirty(4);
+    kv.get_or_load(5, load);
+    ASSERT_EQ(batches, (std::vector<std::vector<std::pair<int, bool>>>{{{1, false}, {2, true}, {3, false}}}));
+
+    kv.get_or_load(6, load);
+    kv.flush();
+    ASSERT_EQ(batches.back(), (std::vector<std::pair<int, bool>>{{4, true}}));
+    kv.flush();
+    ASSERT_EQ(batches.size(), 2);
+}
+
+TEST(kv, otherPolicies) {
+    kv_cache<int, int, fifo_policy> kv(2);
+    auto load = [](int key) { return -key; };
+    kv.get_or_load(1, load);
+    kv.get_or_load(2, load);
+    kv.get_or_load(1, load);
+    kv.get_or_load(3, load);
+    ASSERT_FALSE(kv.isPresent(1));
+    ASSERT_EQ(*kv.get(3), -3);
+}
+
+TEST(kv, coalescesConcurrentMisses) {
+    std::atomic<int> evictions{0};
+    concurrent_kv_cache<int, int> kv(64, 4, [&](auto evicted) { evictions += static_cast<int>(evicted.size()); }, 8);
+
+    constexpr int threads = 8, keys = 256;
+    std::atomic<int> loaderCalls{0};
+    auto slowLoad = [&](int key) {
+        loaderCalls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        return key * 2;
+    };
+
+    // every thread misses on the same key at once: one load
+    std::vector<std::thread> pool;
+    std::atomic<bool> wrong{false};
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back([&] {
+            if (*kv.get_or_load(7, slowLoad) != 14)
+                wrong = true;
+        });
+    for (auto& t : pool)
+        t.join();
+    ASSERT_FALSE(wrong);
+    ASSERT_EQ(loaderCalls, 1);
+    ASSERT_EQ(kv.loads(), 1);
+
+    pool.clear();
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back([&, t] {
+            for (int i = 0; i < 2000; i++) {
+                int key = (i * 7 + t) % keys;
+                if (*kv.get_or_load(key, [](int k) { return k * 2; }) != key * 2)
+                    wrong = true;
+            }
+        });
+    for (auto& t : pool)
+        t.join();
+    ASSERT_FALSE(wrong);
+    kv.flush();
+    // every value loaded beyond the capacity has been evicted exactly once
+    ASSERT_EQ(evictions, static_cast<int>(kv.loads()) - 64);
+
+    ASSERT_THROW(kv.get_or_load(1000, [](int) -> int { throw std::runtime_error("down"); }), std::runtime_error);
+    ASSERT_EQ(kv.get(1000), nullptr);
+}
+
+TEST(basic, slruProtectsHits) {
+    slru_cache<int> slru(10);
+    // 1..8 get a second hit and move to protected (8 slots)
+    for (int round = 0; round < 2; round++)
+        for (int key = 1; key <= 8; key++)
+            slru.lookup_update(key);
+    for (int key = 100; key < 200; key++)
+        slru.lookup_update(key);
+    for (int key = 1; key <= 8; key++)
+        ASSERT_TRUE(slru.isPresent(key)) << key;
+
+    lru_cache<int> lru(10);
+    for (int key = 1; key <= 8; key++)
+        lru.lookup_update(key);
+    for (int key = 100; key < 200; key++)
+        lru.lookup_update(key);
+    ASSERT_FALSE(lru.isPresent(1));
+}
+
+TEST(buffered, hashSetMatchesStdSet) {
+    concurrent_hash_set set(200);
+    std::set<uint64_t> reference;
+    std::mt19937_64 gen(5);
+    for (int i = 0; i < 100000; i++) {
+        // few distinct low bits, so probe sequences collide and wrap
+        uint64_t h = (gen() % 400) * 0x10000000001ULL;
+        if (reference.count(h)) {
+            set.erase(h);
+            reference.erase(h);
+        } else if (reference.size() < 200) {
+            set.insert(h);
+            reference.insert(h);
+        }
+        ASSERT_EQ(set.contains(h), reference.count(h) > 0);
+    }
+    for (uint64_t k = 0; k < 400; k++)
+        ASSERT_EQ(set.contains(k * 0x10000000001ULL), reference.count(k * 0x10000000001ULL) > 0);
+}
+
+template <typename Exact, typename Policy>
+void checkBufferedExact(const std::vector<int>& test, size_t capacity) {
+    buffered_cache<int, Policy> buffered(capacity, 1);
+    Exact exact(capacity);
+    for (size_t i = 0; i < test.size(); i++)
+        ASSERT_EQ(buffered.lookup_update(test[i]), exact.lookup_update(test[i])) << "request " << i;
+    ASSERT_EQ(buffered.stats().dropped, 0);
+}
+
+TEST(buffered, singleThreadIsExact) {
+    std::vector<int> test = skewedTest(50000, 3000, 12);
+    test.push_back(0);
+    test.push_back(0);
+    for (size_t capacity : {1, 50, 300}) {
+        checkBufferedExact<lru_cache<int>, lru_policy>(test, capacity);
+        checkBufferedExact<slru_cache<int>, slru_policy>(test, capacity);
+    }
+}
+
+// every key in one bucket of the policy index
+struct constant_hash {
+    size_t operator()(int) const { return 7; }
+};
+
+TEST(buffered, collidingHashIsExact) {
+    buffered_cache<int, lru_policy, constant_hash> buffered(4, 1);
+    lru_cache<int> exact(4);
+    for (int key : skewedTest(5000, 40, 17))
+        ASSERT_EQ(buffered.lookup_update(key), exact.lookup_update(key));
+    ASSERT_FALSE(buffered.isPresent(1000));
+}
+
+TEST(buffered, concurrentAccuracy) {
+    constexpr int threads = 8, perThread = 50000;
+    std::vector<std::vector<int>> traces;
+    for (int t = 0; t < threads; t++)
+        traces.push_back(workloads::zipf(perThread, 20000, 0.9, 100 + t));
+
+    // the same requests, round-robin, through the exact policy
+    lru_cache<int> exact(2000);
+    size_t exactHits = 0;
+    for (int i = 0; i < perThread; i++)
+        for (int t = 0; t < threads; t++)
+            exactHits += exact.lookup_update(traces[t][i]);
+
+    buffered_cache<int> buffered(2000, 8);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++)
+        pool.emplace_back([&, t] {
+            for (int key : traces[t])
+                buffered.lookup_update(key);
+        });
+    for (auto& t : pool)
+        t.join();
+    buffered.maintenance();
+
+    auto stats = buffered.stats();
+    ASSERT_EQ(stats.lookups(), static_cast<size_t>(threads) * perThread);
+    double exactRatio = static_cast<double>(exactHits) / stats.lookups();
+    ASSERT_NEAR(stats.hit_ratio(), exactRatio, 0.03) << "dropped " << stats.dropped;
+}
+
+TEST(tiered, exclusiveLruIsOneLru) {
+    std::vector<int> test = skewedTest(30000, 3000, 8);
+    basic_cache<lru_policy> l1(50), l2(200);
+    tiered_cache<int, basic_cache<lru_policy>, basic_cache<lru_policy>> tiers(l1, l2, tier_mode::exclusive);
+    lru_cache<int> single(250);
+    for (int key : test) {
+        ASSERT_EQ(tiers.lookup_update(key), single.lookup_update(key));
+        ASSERT_FALSE(l1.isPresent(key) && l2.isPresent(key));
+    }
+    const auto& s = tiers.stats();
+    ASSERT_EQ(s.requests, test.size());
+    ASSERT_GT(s.l1_hits, 0);
+    ASSERT_GT(s.l2_hits, 0);
+    ASSERT_EQ(s.promotions, s.l2_hits);
+}
+
+TEST(tiered, exclusiveWithoutL1) {
+    std::vector<int> test = skewedTest(5000, 1000, 11);
+    basic_cache<lru_policy> l1(0), l2(100);
+    tiered_cache<int, basic_cache<lru_policy>, basic_cache<lru_policy>> tiers(l1, l2, tier_mode::exclusive);
+    lru_cache<int> single(100);
+    for (int key : test)
+        ASSERT_EQ(tiers.lookup_update(key), single.lookup_update(key));
+    const auto& s = tiers.stats();
+    ASSERT_GT(s.l2_hits, 0);
+    ASSERT_EQ(s.promotions, 0);
+    ASSERT_EQ(s.demotions, 0);
+}
+
+TEST(tiered, inclusiveKeepsL1InL2) {
+    std::vector<int> test = skewedTest(30000, 3000, 9);
+    basic_cache<lru_policy> l1(50);
+    basic_cache<slru_policy> l2(200);
+    tiered_cache<int, basic_cache<lru_policy>, basic_cache<slru_policy>> tiers(l1, l2, tier_mode::inclusive);
+    for (int key : test) {
+        tiers.lookup_update(key);
+        l1.for_each([&](int cached, auto) { ASSERT_TRUE(l2.isPresent(cached)) << cached; });
+    }
+    const auto& s = tiers.stats();
+    ASSERT_GT(s.back_invalidations, 0);
+
+    tier_latency latency{1, 10, 100};
+    double expected = (s.requests * 1.0 + (s.requests - s.l1_hits) * 10.0 + s.misses() * 100.0) / s.requests;
+    ASSERT_DOUBLE_EQ(s.mean_latency(latency), expected);
+}
+
+TEST(tiered, fileBackedL2) {
+    auto path = (std::filesystem::temp_directory_path() / "cache_tests_tier.bin").string();
+    std::vector<int> test = skewedTest(5000, 1000, 10);
+    {
+        basic_cache<lru_policy> l1(20);
+        file_tier<int> l2(100, path, 64);
+        ASSERT_EQ(std::filesystem::file_size(path), 100 * 64);
+
+        tiered_cache<int, basic_cache<lru_policy>, file_tier<int>> tiers(l1, l2, tier_mode::exclusive);
+        lru_cache<int> single(120);
+        for (int key : test)
+            ASSERT_EQ(tiers.lookup_update(key), single.lookup_update(key));
+        ASSERT_EQ(l2.bytes_read(), tiers.stats().l2_hits * 64);
+        ASSERT_EQ(l2.bytes_written(), tiers.stats().demotions * 64);
+    }
+    std::filesystem::remove(path);
+}
+
+
+TEST(snapshot, restoreContinuesIdentically) {
+    auto path = (std::filesystem::temp_directory_path() / "cache_tests_lru2.snap").string();
+    std::vector<int> test = skewedTest(20000, 1000, 12);
+    auto middle = test.begin() + test.size() / 2;
+
+    lru_2_cache<int> warm(200, 60);
+    for (auto it = test.begin(); it != middle; ++it)
+        warm.lookup_update(*it);
+    save_snapshot(warm, path);
+    ASSERT_EQ(std::filesystem::file_size(path), sizeof(snapshot_header) + 200 * sizeof(int));
+
+    lru_2_cache<int> restored(200, 60);
+    ASSERT_EQ(restore_snapshot(restored, path), 200);
+    for (auto it = middle; it != test.end(); ++it)
+        ASSERT_EQ(restored.lookup_update(*it), warm.lookup_update(*it));
+    std::filesystem::remove(path);
+}
+
+TEST(snapshot, adaptiveKeepsSplit) {
+    auto path = (std::filesystem::temp_directory_path() / "cache_tests_lru2a.snap").string();
+    adaptive_lru_2_cache<int> cache(100);
+    for (int key : skewedTest(20000, 1000, 13))
+        cache.lookup_update(key);
+    ASSERT_NE(cache.candidate_capacity(), 50);
+    save_snapshot(cache, path);
+
+    adaptive_lru_2_cache<int> restored(100);
+    restore_snapshot(restored, path);
+    ASSERT_EQ(restored.candidate_capacity(), cache.candidate_capacity());
+    for (int key = 0; key < 1000; key++)
+        ASSERT_EQ(restored.isPresent(key), cache.isPresent(key));
+
+    // a fixed cache keeps its own split
+    lru_2_cache<int> fixed(100);
+    restore_snapshot(fixed, path);
+    ASSERT_EQ(fixed.candidate_capacity(), 50);
+    std::filesystem::remove(path);
+}
+
+TEST(snapshot, smallerCacheAndBadFiles) {
+    auto path = (std::filesystem::temp_directory_path() / "cache_tests_lru2b.snap").string();
+    lru_2_cache<int> cache(10, 4);
+    // free candidate slots fill first: candidates are 0..3, hot 4..9
+    for (int key = 0; key < 10; key++)
+        cache.lookup_update(key);
+    save_snapshot(cache, path);
+
+    // the most recent keys of each list are kept
+    lru_2_cache<int> small(4, 2);
+    restore_snapshot(small, path);
+    for (int key : {2, 3, 8, 9})
+        ASSERT_TRUE(small.isPresent(key));
+    ASSERT_FALSE(small.isPresent(1) || small.isPresent(7));
+
+    lru_2_cache<long long> wide(10);
+    ASSERT_THROW(restore_snapshot(wide, path), std::runtime_error);
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    ASSERT_THROW(restore_snapshot(small, path), std::runtime_error);
+    ASSERT_TRUE(small.isPresent(9));
+    std::filesystem::remove(path);
+}
+
+TEST(snapshot, corruptCountsThrow) {
+    auto path = (std::filesystem::temp_directory_path() / "cache_tests_lru2c.snap").string();
+    lru_2_cache<int> cache(10, 4);
+    for (int key = 0; key < 10; key++)
+        cache.lookup_update(key);
+    save_snapshot(cache, path);
+
+    // counts whose sum wraps to the 10 keys stored
+    auto corrupt = [&](std::uint64_t candidates, std::uint64_t hot) {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        snapshot_header header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        header.candidates = candidates;
+        header.hot = hot;
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    };
+    lru_2_cache<int> restored(10, 4);
+    restored.lookup_update(42);
+    corrupt(~std::uint64_t{0}, 11);
+    ASSERT_THROW(restore_snapshot(restored, path), std::runtime_error);
+    corrupt(5, ~std::uint64_t{0} - 4);
+    ASSERT_THROW(restore_snapshot(restored, path), std::runtime_error);
+    ASSERT_TRUE(restored.isPresent(42));
+
+    corrupt(3, 7);
+    ASSERT_EQ(restore_snapshot(restored, path), 10);
+    std::filesystem::remove(path);
+}
+
+TEST(dense, matchesHashedIndex) {
+    std::vector<int> test = skewedTest(50000, 5000, 14);
+    lru_cache<int> lru(300);
+    fifo_cache<int> fifo(300);
+    slru_cache<int> slru(300);
+    dense_cache<int> denseLru(300, key_universe{5000});
+    dense_cache<int, fifo_policy> denseFifo(300, key_universe{5000});
+    dense_cache<int, slru_policy> denseSlru(300, key_universe{5000});
+    for (int key : test) {
+        ASSERT_EQ(denseLru.lookup_update(key), lru.lookup_update(key));
+        ASSERT_EQ(denseFifo.lookup_update(key), fifo.lookup_update(key));
+        ASSERT_EQ(denseSlru.lookup_update(key), slru.lookup_update(key));
+    }
+    for (int key = 0; key < 5000; key++)
+        ASSERT_EQ(denseLru.isPresent(key), lru.isPresent(key));
+
+    denseLru.remove(test.back());
+    ASSERT_FALSE(denseLru.isPresent(test.back()));
+    denseLru.clear();
+    ASSERT_FALSE(denseLru.isPresent(test.front()));
+}
+
+TEST(dense, keysOutsideUniverse) {
+    dense_cache<int> cache(4, key_universe{10});
+    for (int key : {0, 9, 3})
+        cache.lookup_update(key);
+    ASSERT_THROW(cache.lookup_update(10), std::out_of_range);
+    ASSERT_THROW(cache.lookup_update(-1), std::out_of_range);
+    ASSERT_THROW(cache.isPresent(10), std::out_of_range);
+    // nothing changed
+    ASSERT_EQ(cache.size(), 3);
+    ASSERT_TRUE(cache.lookup_update(9));
+
+    ASSERT_THROW((dense_cache<long long>(4, key_universe{(size_t{1} << 32) + 1})), std::invalid_argument);
+}
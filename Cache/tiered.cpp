@@ -0,0 +1,152 @@
+#include "basic_cache.hpp"
+#include "tiered.hpp"
+#include "trace.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace caches;
+
+namespace {
+    struct level {
+        std::string policy = "lru";
+        // unset: the default of the level, derived from the trace
+        std::optional<size_t> capacity;
+    };
+
+    struct options {
+        tier_mode mode = tier_mode::inclusive;
+        level l1, l2;
+        tier_latency latency;
+        std::string file;
+        size_t value_size = 4096;
+        std::string trace;
+    };
+
+    // the whole text must be a decimal number
+    bool parse_size(std::string_view text, size_t& value) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc{} && ptr == text.data() + text.size();
+    }
+
+    // "policy:capacity", or just the policy; a capacity of 0 is a level that
+    // holds nothing
+    bool parse_level(const std::string& spec, level& l) {
+        auto colon = spec.find(':');
+        l.policy = spec.substr(0, colon);
+        if (colon != std::string::npos) {
+            size_t capacity;
+            if (!parse_size(std::string_view(spec).substr(colon + 1), capacity))
+                return false;
+            l.capacity = capacity;
+        }
+        return l.policy == "lru" || l.policy == "fifo" || l.policy == "slru";
+    }
+
+    bool parse(int argc, char** argv, options& opts) {
+        int i = 1;
+        for (; i + 1 < argc; i += 2) {
+            std::string flag = argv[i], value = argv[i + 1];
+            if (flag == "--mode") {
+                if (value != "inclusive" && value != "exclusive")
+                    return false;
+                opts.mode = value == "inclusive" ? tier_mode::inclusive : tier_mode::exclusive;
+            } else if (flag == "--l1") {
+                if (!parse_level(value, opts.l1))
+                    return false;
+            } else if (flag == "--l2") {
+                if (!parse_level(value, opts.l2))
+                    return false;
+            } else if (flag == "--latency") {
+                if (std::sscanf(value.c_str(), "%lf,%lf,%lf", &opts.latency.l1, &opts.latency.l2, &opts.latency.backend) != 3)
+                    return false;
+            } else if (flag == "--file") {
+                opts.file = value;
+            } else if (flag == "--value-size") {
+                if (!parse_size(value, opts.value_size) || opts.value_size == 0)
+                    return false;
+            } else {
+                break;
+            }
+        }
+        if (i < argc)
+            opts.trace = argv[i++];
+        return i == argc;
+    }
+
+    // calls f with the named eviction policy
+    template <typename F>
+    void with_policy(const std::string& policy, F f) {
+        if (policy == "lru")
+            f(lru_policy{});
+        else if (policy == "fifo")
+            f(fifo_policy{});
+        else
+            f(slru_policy{});
+    }
+
+    template <typename L1, typename L2>
+    void run(L1& l1, L2& l2, const options& opts, const trace& requests) {
+        tiered_cache<int, L1, L2> tiers(l1, l2, opts.mode);
+        auto start = std::chrono::steady_clock::now();
+        for (auto q : requests)
+            tiers.lookup_update(int_key(q));
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const auto& s = tiers.stats();
+        std::printf("requests %zu\n", s.requests);
+        std::printf("l1 %s %zu hits %zu hit_ratio %.4f\n", opts.l1.policy.c_str(), *opts.l1.capacity, s.l1_hits, s.l1_hit_ratio());
+        std::printf("l2 %s %zu hits %zu hit_ratio %.4f\n", opts.l2.policy.c_str(), *opts.l2.capacity, s.l2_hits, s.l2_hit_ratio());
+        std::printf("total hit_ratio %.4f misses %zu\n", s.hit_ratio(), s.misses());
+        std::printf("promotions %zu demotions %zu back_invalidations %zu\n", s.promotions, s.demotions, s.back_invalidations);
+        std::printf("model mean_latency %.1f (l1 %.1f l2 %.1f backend %.1f)\n", s.mean_latency(opts.latency),
+                    opts.latency.l1, opts.latency.l2, opts.latency.backend);
+        std::printf("replay seconds %.3f\n", seconds);
+    }
+}
+
+// Simulates an L1 over an L2, each "policy:capacity" with policy lru, fifo
+// or slru (default: lru, capacities m and 10 m; 0 leaves a level empty),
+// inclusive or exclusive. It prints the hit ratio of each level and the mean
+// latency under --latency l1,l2,backend. With --file the L2 keeps
+// --value-size bytes per key in that file, preallocated, and the replay time
+// includes its I/O.
+int main(int argc, char** argv) try {
+    options opts;
+    if (!parse(argc, argv, opts)) {
+        std::cerr << "usage: tiered [--mode inclusive|exclusive] [--l1 policy:capacity] [--l2 policy:capacity]"
+                     " [--latency l1,l2,backend] [--file path [--value-size B]] [trace file]\n";
+        return 1;
+    }
+
+    auto requests = opts.trace.empty() ? trace::parse(std::cin) : trace::open(opts.trace);
+    if (!opts.l1.capacity)
+        opts.l1.capacity = requests.capacity();
+    if (!opts.l2.capacity)
+        opts.l2.capacity = 10 * requests.capacity();
+
+    with_policy(opts.l1.policy, [&](auto p1) {
+        basic_cache<decltype(p1)> l1(*opts.l1.capacity);
+        with_policy(opts.l2.policy, [&](auto p2) {
+            if (opts.file.empty()) {
+                basic_cache<decltype(p2)> l2(*opts.l2.capacity);
+                run(l1, l2, opts, requests);
+                return;
+            }
+            file_tier<int, decltype(p2)> l2(*opts.l2.capacity, opts.file, opts.value_size);
+            run(l1, l2, opts, requests);
+            std::printf("l2 file %s bytes_read %llu bytes_written %llu\n", opts.file.c_str(),
+                        static_cast<unsigned long long>(l2.bytes_read()), static_cast<unsigned long long>(l2.bytes_written()));
+        });
+    });
+    return 0;
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "basic_cache.hpp"
+#include "slab.hpp"
+
+// Two-level cache hierarchies: an L1 (memory) over an L2 (disk), each with
+// its own policy, in front of a backend that serves the misses of both.
+namespace caches {
+    enum class tier_mode {
+        // L2 holds everything L1 does; an L2 eviction invalidates the L1 copy
+        inclusive,
+        // a key is in one level at most; L1 victims are demoted into L2 and
+        // L2 hits are promoted out of it
+        exclusive,
+    };
+
+    // A level of the hierarchy: basic_cache and anything with its interface.
+    template <typename C, typename KeyT>
+    concept cache_tier = requires(C c, const C cc, KeyT key) {
+        { cc.isPresent(key) } -> std::convertible_to<bool>;
+        c.lookup_update(key);
+        c.remove(key);
+        { cc.victim_key() } -> std::convertible_to<KeyT>;
+        { cc.full() } -> std::convertible_to<bool>;
+        { cc.capacity() } -> std::convertible_to<size_t>;
+    };
+
+    // Cost of one access to each level, in any time unit (ns by default).
+    struct tier_latency {
+        double l1 = 100.0;
+        double l2 = 20000.0;
+        double backend = 1000000.0;
+    };
+
+    struct tier_stats {
+        size_t requests = 0;
+        size_t l1_hits = 0;
+        size_t l2_hits = 0;
+        size_t promotions = 0;
+        size_t demotions = 0;
+        // L1 copies dropped because L2 evicted the key (inclusive only)
+        size_t back_invalidations = 0;
+
+        size_t misses() const { return requests - l1_hits - l2_hits; }
+        double l1_hit_ratio() const { return requests ? static_cast<double>(l1_hits) / requests : 0.0; }
+        // local hit ratio: of the requests that reached L2
+        double l2_hit_ratio() const {
+            size_t reached = requests - l1_hits;
+            return reached ? static_cast<double>(l2_hits) / reached : 0.0;
+        }
+        double hit_ratio() const { return requests ? static_cast<double>(l1_hits + l2_hits) / requests : 0.0; }
+
+        // Every request pays L1, requests missing L1 also pay L2, and misses
+        // pay the backend on top.
+        double mean_latency(const tier_latency& t) const {
+            if (requests == 0)
+                return 0.0;
+            double total = requests * t.l1 + (requests - l1_hits) * t.l2 + misses() * t.backend;
+            return total / requests;
+        }
+    };
+
+    // Replays requests through L1 over L2. The levels are owned by the caller
+    // and only accessed through the cache_tier interface, so any pair of
+    // policies (or a file_tier as L2) can be composed.
+    template <typename KeyT, cache_tier<KeyT> L1, cache_tier<KeyT> L2>
+    class tiered_cache {
+    public:
+        tiered_cache(L1& l1, L2& l2, tier_mode mode) : l1_{l1}, l2_{l2}, mode_{mode} {}
+
+        // true on a hit in either level
+        bool lookup_update(const KeyT& key) {
+            stats_.requests++;
+            if (l1_.isPresent(key)) {
+                l1_.lookup_update(key);
+                stats_.l1_hits++;
+                return true;
+            }
+
+            bool hit = l2_.isPresent(key);
+            if (hit)
+                stats_.l2_hits++;
+            if (mode_ == tier_mode::inclusive)
+                inclusive_fill(key, hit);
+            else
+                exclusive_fill(key, hit);
+            return hit;
+        }
+
+        const tier_stats& stats() const { return stats_; }
+        tier_mode mode() const { return mode_; }
+
+    private:
+        void inclusive_fill(const KeyT& key, bool l2Hit) {
+            if (!l2Hit && l2_.full() && l2_.capacity() > 0) {
+                KeyT victim = l2_.victim_key();
+                if (l1_.isPresent(victim)) {
+                    l1_.remove(victim);
+                    stats_.back_invalidations++;
+                }
+            }
+            l2_.lookup_update(key);
+            if (l2_.isPresent(key)) {
+                l1_.lookup_update(key);
+                stats_.promotions += l2Hit;
+            }
+        }
+
+        void exclusive_fill(const KeyT& key, bool l2Hit) {
+            // without an L1 every key stays in L2 and nothing is promoted
+            if (l1_.capacity() == 0) {
+                l2_.lookup_update(key);
+                return;
+            }
+            if (l2Hit) {
+                // the hit itself, so that a file-backed L2 reads the value
+                l2_.lookup_update(key);
+                l2_.remove(key);
+                stats_.promotions++;
+            }
+            if (l1_.full()) {
+                KeyT victim = l1_.victim_key();
+                l1_.remove(victim);
+                l2_.lookup_update(victim);
+                stats_.demotions++;
+            }
+            l1_.lookup_update(key);
+        }
+
+    private:
+        L1& l1_;
+        L2& l2_;
+        tier_mode mode_;
+        tier_stats stats_;
+    };
+
+    // A cache level that keeps its values in a local file preallocated to
+    // capacity * value_size bytes. The policy's node of a key is its slot in
+    // the file: an admission writes the value there and a hit reads it back,
+    // so replays through it do real I/O. Values are synthetic, the key
+    // followed by a fill pattern, and are checked on every read.
+    template <typename KeyT = int, typename EvictionPolicy = lru_policy, typename Hash = std::hash<KeyT>>
+    class file_tier : public basic_cache<EvictionPolicy, slab_storage<KeyT>, open_index<KeyT, Hash>> {
+        using base = basic_cache<EvictionPolicy, slab_storage<KeyT>, open_index<KeyT, Hash>>;
+
+    public:
+        using size_type = size_t;
+
+    public:
+        file_tier(size_type capacity, const std::string& path, size_type value_size = 4096) :
+            base(capacity), value_size_{std::max(value_size, sizeof(KeyT))}, buffer_(value_size_) {
+            fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd_ < 0)
+                throw std::runtime_error("cannot open " + path);
+            auto bytes = static_cast<off_t>(capacity * value_size_);
+            if (bytes > 0 && ::posix_fallocate(fd_, 0, bytes) != 0 && ::ftruncate(fd_, bytes) != 0) {
+                ::close(fd_);
+                throw std::runtime_error("cannot preallocate " + path);
+            }
+        }
+
+        file_tier(const file_tier&) = delete;
+        file_tier& operator=(const file_tier&) = delete;
+
+        ~file_tier() { ::close(fd_); }
+
+        bool lookup_update(const KeyT& key) {
+            if (this->isPresent(key)) {
+                read(key, this->node_of(key));
+                return base::lookup_update(key);
+            }
+            base::lookup_update(key);
+            if (auto node = this->node_of(key); node != base::npos)
+                write(key, node);
+            return false;
+        }
+
+        std::uint64_t bytes_read() const { return read_; }
+        std::uint64_t bytes_written() const { return written_; }
+        size_type value_size() const { return value_size_; }
+
+    private:
+        void write(const KeyT& key, typename base::index_type node) {
+            std::memset(buffer_.data(), static_cast<int>(node & 0xff), buffer_.size());
+            std::memcpy(buffer_.data(), &key, sizeof(KeyT));
+            if (::pwrite(fd_, buffer_.data(), buffer_.size(), offset(node)) != static_cast<ssize_t>(buffer_.size()))
+                throw std::runtime_error("tier file write failed");
+            written_ += buffer_.size();
+        }
+
+        void read(const KeyT& key, typename base::index_type node) {
+            if (::pread(fd_, buffer_.data(), buffer_.size(), offset(node)) != static_cast<ssize_t>(buffer_.size()))
+                throw std::runtime_error("tier file read failed");
+            if (std::memcmp(buffer_.data(), &key, sizeof(KeyT)) != 0)
+                throw std::runtime_error("tier file holds another key in this slot");
+            read_ += buffer_.size();
+        }
+
+        off_t offset(typename base::index_type node) const { return static_cast<off_t>(node) * static_cast<off_t>(value_size_); }
+
+    private:
+        size_type value_size_;
+        std::vector<unsigned char> buffer_;
+        int fd_ = -1;
+        std::uint64_t read_ = 0;
+        std::uint64_t written_ = 0;
+    };
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "batch.hpp"
+#include "slab.hpp"
+
+namespace caches {
+    // Approximate access frequencies for TinyLFU admission. Counters are 4 bits
+    // wide, 16 to a word, in `depth` rows; the estimate is the minimum over the
+    // rows. A doorkeeper Bloom filter absorbs the first occurrence of every key,
+    // so one-hit wonders never reach the sketch. Every `sample` increments all
+    // counters are halved and the doorkeeper is cleared, which lets the
+    // frequencies follow a changing workload.
+    template <typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class frequency_sketch {
+    public:
+        using size_type = size_t;
+
+        static constexpr size_type depth = 4;
+
+    public:
+        frequency_sketch(size_type capacity) {
+            // 4 counters per entry and row, one 64-bit word per entry in total
+            size_type width = 16;
+            while (width < 4 * capacity)
+                width *= 2;
+            width_mask_ = width - 1;
+            table_.assign(depth * width / 16, 0);
+            sample_ = std::max<size_type>(10 * capacity, 16);
+
+            // sized for the distinct keys of one sample period at ~15% false positives
+            size_type bits = 64;
+            while (bits < 4 * sample_)
+                bits *= 2;
+            door_mask_ = bits - 1;
+            doorkeeper_.assign(bits / 64, 0);
+        }
+
+        void increment(const KeyT& key) {
+            std::uint64_t h = hash(key);
+            if (!doorkeeper_test_and_set(h)) {
+                tick();
+                return;
+            }
+
+            for (size_type row = 0; row < depth; row++) {
+                size_type i = counter(h, row);
+                std::uint64_t& word = table_[i / 16];
+                unsigned shift = (i % 16) * 4;
+                if (((word >> shift) & 0xf) != 0xf)
+                    word += std::uint64_t{1} << shift;
+            }
+            tick();
+        }
+
+        unsigned estimate(const KeyT& key) const {
+            std::uint64_t h = hash(key);
+            unsigned freq = 15;
+            for (size_type row = 0; row < depth; row++) {
+                size_type i = counter(h, row);
+                freq = std::min<unsigned>(freq, (table_[i / 16] >> ((i % 16) * 4)) & 0xf);
+            }
+            return freq + doorkeeper_test(h);
+        }
+
+    private:
+        std::uint64_t hash(const KeyT& key) const { return mix_hash(static_cast<std::uint64_t>(hasher_(key)) ^ 0x9e3779b97f4a7c15ULL); }
+
+        // double hashing: row r uses h1 + r * h2 within its own block of counters
+        size_type counter(std::uint64_t h, size_type row) const {
+            std::uint64_t h1 = h & 0xffffffff, h2 = (h >> 32) | 1;
+            return row * (width_mask_ + 1) + ((h1 + row * h2) & width_mask_);
+        }
+
+        bool doorkeeper_test(std::uint64_t h) const {
+            std::uint64_t a = h & door_mask_, b = (h >> 32) & door_mask_;
+            return (doorkeeper_[a / 64] >> (a % 64) & 1) && (doorkeeper_[b / 64] >> (b % 64) & 1);
+        }
+
+        // returns whether the key was already there
+        bool doorkeeper_test_and_set(std::uint64_t h) {
+            bool present = doorkeeper_test(h);
+            std::uint64_t a = h & door_mask_, b = (h >> 32) & door_mask_;
+            doorkeeper_[a / 64] |= std::uint64_t{1} << (a % 64);
+            doorkeeper_[b / 64] |= std::uint64_t{1} << (b % 64);
+            return present;
+        }
+
+        void tick() {
+            if (++additions_ < sample_)
+                return;
+            additions_ = 0;
+            for (auto& word : table_)
+                word = (word >> 1) & 0x7777777777777777ULL;
+            std::fill(doorkeeper_.begin(), doorkeeper_.end(), 0);
+        }
+
+    private:
+        std::vector<std::uint64_t> table_;
+        std::vector<std::uint64_t> doorkeeper_;
+        size_type width_mask_;
+        size_type door_mask_;
+        size_type sample_;
+        size_type additions_ = 0;
+        [[no_unique_address]] Hash hasher_;
+    };
+
+    // W-TinyLFU (Einziger, Friedman & Manes, 2017). New keys enter a small LRU
+    // window (1% of capacity). Keys leaving the window compete for the main
+    // segmented LRU with its probation victim and are only admitted if the
+    // sketch has seen them more often. Main is split 20/80 into probation and
+    // protected; a hit in probation promotes to protected.
+    template<typename KeyT = int, typename Hash = std::hash<KeyT>>
+    class tinylfu_cache {
+    public:
+        using size_type = size_t;
+        using hash_type = typename slab_list<KeyT, Hash>::hash_type;
+    public:
+        tinylfu_cache(size_type capacity) :
+            cap{capacity},
+            windowCap{capacity ? std::max<size_type>(capacity / 100, 1) : 0},
+            protectedCap{(capacity - windowCap) * 4 / 5},
+            probationCap{capacity - windowCap - protectedCap},
+            // probation takes all of main until protected fills up
+            window{windowCap}, probation{capacity - windowCap}, protectedPages{protectedCap},
+            sketch{capacity} {}
+
+        bool full() const { return window.size() + probation.size() + protectedPages.size() == cap; }
+
+        bool lookup_update(KeyT key) { return lookup_update(key, hash(key)); }
+        bool lookup_update(KeyT key, hash_type h);
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return window.hash(key); }
+        void prefetch(hash_type h) const {
+            window.prefetch(h);
+            probation.prefetch(h);
+            protectedPages.prefetch(h);
+        }
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            window.prefetch_entry(key, h);
+            probation.prefetch_entry(key, h);
+            protectedPages.prefetch_entry(key, h);
+        }
+
+        bool isPresent(KeyT key) const {
+            return window.contains(key) || probation.contains(key) || protectedPages.contains(key);
+        }
+
+    private:
+        void admit(KeyT candidate);
+
+    private:
+        size_type cap;
+        size_type windowCap;
+        size_type protectedCap;
+        size_type probationCap;
+        slab_list<KeyT, Hash> window;
+        slab_list<KeyT, Hash> probation;
+        slab_list<KeyT, Hash> protectedPages;
+        frequency_sketch<KeyT, Hash> sketch;
+    };
+
+    template <typename KeyT, typename Hash>
+    bool tinylfu_cache<KeyT, Hash>::lookup_update(KeyT key, hash_type h) {
+        sketch.increment(key);
+
+        if (auto hit = window.find(key, h); hit != window.npos) {
+            window.move_to_front(hit);
+            return true;
+        }
+        if (auto hit = protectedPages.find(key, h); hit != protectedPages.npos) {
+            protectedPages.move_to_front(hit);
+            return true;
+        }
+        if (auto hit = probation.find(key, h); hit != probation.npos) {
+            // too small a cache for a protected segment
+            if (protectedCap == 0) {
+                probation.move_to_front(hit);
+                return true;
+            }
+            probation.erase(hit);
+            if (protectedPages.size() >= protectedCap && !protectedPages.empty())
+                probation.push_front(protectedPages.pop_back());
+            protectedPages.push_front(key, h);
+            return true;
+        }
+
+        if (cap == 0)
+            return false;
+
+        if (window.full())
+            admit(window.pop_back());
+        window.push_front(key, h);
+        return false;
+    }
+
+    template <typename KeyT, typename Hash>
+    void tinylfu_cache<KeyT, Hash>::admit(KeyT candidate) {
+        if (probation.size() + protectedPages.size() < probationCap + protectedCap) {
+            probation.push_front(candidate);
+            return;
+        }
+
+        auto& victims = probation.empty() ? protectedPages : probation;
+        if (victims.empty())
+            return;
+        if (sketch.estimate(candidate) <= sketch.estimate(victims.key(victims.back())))
+            return;
+
+        victims.pop_back();
+        probation.push_front(candidate);
+    }
+}
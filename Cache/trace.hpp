@@ -0,0 +1,413 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Request traces. The text format is the one the drivers always read:
+// "m n" followed by n keys. The binary format is a 32-byte header followed by
+// the keys, either fixed-width or as zigzag varints of the delta to the
+// previous key. Binary files are memory-mapped and decoded in place. All
+// integers are stored little-endian, as laid out by the host.
+//
+// Sized traces carry an object size with every request: "key:size" in text
+// (m is then a capacity in bytes), and in binary the trace_flags::sized flag
+// with the size stored right after each key, in the same width for the fixed
+// encodings and as an unsigned varint for varint_delta. Requests of unsized
+// traces have size 1.
+namespace caches {
+    enum class trace_encoding : std::uint16_t {
+        fixed32 = 0,
+        fixed64 = 1,
+        varint_delta = 2,
+    };
+
+    namespace trace_flags {
+        inline constexpr std::uint32_t sized = 1;
+    }
+
+    struct sized_key {
+        std::int64_t key;
+        std::uint64_t size;
+    };
+
+    struct trace_header {
+        char magic[4] = {'C', 'T', 'R', 'C'};
+        std::uint16_t version = 1;
+        trace_encoding encoding = trace_encoding::fixed32;
+        std::uint32_t flags = 0;
+        std::uint32_t reserved = 0;
+        std::uint64_t capacity = 0;
+        std::uint64_t count = 0;
+
+        bool valid() const { return std::memcmp(magic, trace_header{}.magic, sizeof(magic)) == 0 && version == 1; }
+    };
+    static_assert(sizeof(trace_header) == 32);
+
+    // Read-only mapping of a whole file.
+    class mapped_file {
+    public:
+        mapped_file() = default;
+
+        explicit mapped_file(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("cannot open " + path);
+
+            struct stat st;
+            if (::fstat(fd, &st) < 0) {
+                ::close(fd);
+                throw std::runtime_error("cannot stat " + path);
+            }
+            size_ = static_cast<size_t>(st.st_size);
+
+            if (size_ > 0) {
+                void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED) {
+                    ::close(fd);
+                    throw std::runtime_error("cannot map " + path);
+                }
+                data_ = static_cast<const unsigned char*>(data);
+                ::madvise(data, size_, MADV_SEQUENTIAL);
+            }
+            ::close(fd);
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        mapped_file(mapped_file&& other) noexcept { swap(other); }
+        mapped_file& operator=(mapped_file&& other) noexcept {
+            mapped_file tmp(std::move(other));
+            swap(tmp);
+            return *this;
+        }
+
+        ~mapped_file() {
+            if (data_)
+                ::munmap(const_cast<unsigned char*>(data_), size_);
+        }
+
+        const unsigned char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        void swap(mapped_file& other) noexcept {
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+        }
+
+    private:
+        const unsigned char* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Decodes keys straight out of the encoded bytes.
+    class trace_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::int64_t;
+        using reference = value_type;
+        using pointer = void;
+
+    public:
+        trace_iterator() = default;
+        trace_iterator(const unsigned char* pos, const unsigned char* end, trace_encoding enc, std::uint64_t left,
+                       bool sized = false) :
+            pos_{pos}, end_{end}, enc_{enc}, left_{left}, sized_{sized} {
+            decode();
+        }
+
+        value_type operator*() const { return key_; }
+
+        // size of the current request, 1 for unsized traces
+        std::uint64_t object_size() const { return size_; }
+
+        trace_iterator& operator++() {
+            left_--;
+            decode();
+            return *this;
+        }
+
+        trace_iterator operator++(int) {
+            trace_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        // iterators are only compared against the end, which has nothing left
+        bool operator==(const trace_iterator& rhs) const { return left_ == rhs.left_; }
+        bool operator!=(const trace_iterator& rhs) const { return !(*this == rhs); }
+
+    private:
+        void decode() {
+            if (left_ == 0)
+                return;
+
+            switch (enc_) {
+            case trace_encoding::fixed32: {
+                std::int32_t v;
+                read(&v, sizeof(v));
+                key_ = v;
+                break;
+            }
+            case trace_encoding::fixed64:
+                read(&key_, sizeof(key_));
+                break;
+            case trace_encoding::varint_delta: {
+                std::uint64_t zz = read_varint();
+                std::int64_t delta = static_cast<std::int64_t>(zz >> 1) ^ -static_cast<std::int64_t>(zz & 1);
+                key_ = static_cast<std::int64_t>(static_cast<std::uint64_t>(key_) + static_cast<std::uint64_t>(delta));
+                break;
+            }
+            default:
+                throw std::runtime_error("unknown trace encoding");
+            }
+
+            if (!sized_)
+                return;
+            switch (enc_) {
+            case trace_encoding::fixed32: {
+                std::uint32_t v;
+                read(&v, sizeof(v));
+                size_ = v;
+                break;
+            }
+            case trace_encoding::fixed64:
+                read(&size_, sizeof(size_));
+                break;
+            default:
+                size_ = read_varint();
+                break;
+            }
+        }
+
+        std::uint64_t read_varint() {
+            std::uint64_t v = 0;
+            for (int shift = 0;; shift += 7) {
+                if (pos_ == end_ || shift > 63)
+                    throw std::runtime_error("truncated trace");
+                unsigned char byte = *pos_++;
+                v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return v;
+            }
+        }
+
+        void read(void* out, size_t width) {
+            if (static_cast<size_t>(end_ - pos_) < width)
+                throw std::runtime_error("truncated trace");
+            std::memcpy(out, pos_, width);
+            pos_ += width;
+        }
+
+    private:
+        const unsigned char* pos_ = nullptr;
+        const unsigned char* end_ = nullptr;
+        trace_encoding enc_ = trace_encoding::fixed32;
+        std::uint64_t left_ = 0;
+        bool sized_ = false;
+        std::int64_t key_ = 0;
+        std::uint64_t size_ = 1;
+    };
+
+    // A loaded trace: a mapped binary file, or a text trace parsed into memory
+    // and then served as if it were fixed64-encoded.
+    class trace {
+    public:
+        using size_type = size_t;
+
+    public:
+        trace() = default;
+
+        // binary if the file starts with the trace magic, text otherwise
+        static trace open(const std::string& path) {
+            trace t;
+            t.file_ = mapped_file(path);
+            if (t.file_.size() >= sizeof(trace_header)) {
+                std::memcpy(&t.header_, t.file_.data(), sizeof(trace_header));
+                if (t.header_.valid()) {
+                    t.data_ = t.file_.data() + sizeof(trace_header);
+                    t.end_ = t.file_.data() + t.file_.size();
+                    return t;
+                }
+            }
+
+            t.header_ = trace_header{};
+            const char* text = reinterpret_cast<const char*>(t.file_.data());
+            t.parse_text(text, text + t.file_.size());
+            t.file_ = mapped_file{};
+            return t;
+        }
+
+        static trace parse(std::istream& in) {
+            std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+            trace t;
+            t.parse_text(text.data(), text.data() + text.size());
+            return t;
+        }
+
+        size_type capacity() const { return header_.capacity; }
+        size_type size() const { return header_.count; }
+        trace_encoding encoding() const { return header_.encoding; }
+        bool sized() const { return header_.flags & trace_flags::sized; }
+
+        trace_iterator begin() const {
+            return trace_iterator(data_, end_, header_.encoding, header_.count, sized());
+        }
+        trace_iterator end() const { return trace_iterator{}; }
+
+    private:
+        void parse_text(const char* pos, const char* end) {
+            auto next = [&](auto& value) {
+                while (pos != end && (*pos == ' ' || *pos == '\n' || *pos == '\t' || *pos == '\r'))
+                    pos++;
+                auto [ptr, ec] = std::from_chars(pos, end, value);
+                if (ec != std::errc{})
+                    throw std::runtime_error("failed to read input");
+                pos = ptr;
+            };
+
+            next(header_.capacity);
+            next(header_.count);
+            header_.encoding = trace_encoding::fixed64;
+            keys_.resize(header_.count);
+            std::vector<std::int64_t> sizes;
+            for (size_t i = 0; i < keys_.size(); i++) {
+                next(keys_[i]);
+                if (pos == end || *pos != ':')
+                    continue;
+                pos++;
+                if (sizes.empty())
+                    sizes.resize(keys_.size(), 1);
+                next(sizes[i]);
+                if (sizes[i] < 0)
+                    throw std::runtime_error("negative object size");
+            }
+
+            // "key:size" anywhere makes it a sized trace, served as sized fixed64
+            if (!sizes.empty()) {
+                header_.flags |= trace_flags::sized;
+                std::vector<std::int64_t> both(2 * keys_.size());
+                for (size_t i = 0; i < keys_.size(); i++) {
+                    both[2 * i] = keys_[i];
+                    both[2 * i + 1] = sizes[i];
+                }
+                keys_ = std::move(both);
+            }
+
+            data_ = reinterpret_cast<const unsigned char*>(keys_.data());
+            end_ = data_ + keys_.size() * sizeof(std::int64_t);
+        }
+
+    private:
+        trace_header header_;
+        mapped_file file_;
+        std::vector<std::int64_t> keys_;
+        const unsigned char* data_ = nullptr;
+        const unsigned char* end_ = nullptr;
+    };
+
+    // Traces carry 64-bit keys, the drivers run their caches on int: a key out
+    // of range is an error rather than an alias of another key.
+    inline int int_key(std::int64_t key) {
+        if (key < std::numeric_limits<int>::min() || key > std::numeric_limits<int>::max())
+            throw std::range_error("trace key " + std::to_string(key) + " does not fit int");
+        return static_cast<int>(key);
+    }
+
+    // Writes a binary trace of keys, or a sized trace when It yields sized_key.
+    template <typename It>
+    void write_trace(std::ostream& out, std::uint64_t capacity, std::uint64_t count, It begin, It end,
+                     trace_encoding encoding = trace_encoding::varint_delta) {
+        constexpr bool sized = std::is_same_v<std::decay_t<decltype(*begin)>, sized_key>;
+
+        trace_header header;
+        header.encoding = encoding;
+        header.flags = sized ? trace_flags::sized : 0;
+        header.capacity = capacity;
+        header.count = count;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        char buf[10];
+        auto write_varint = [&](std::uint64_t v) {
+            int len = 0;
+            do {
+                unsigned char byte = v & 0x7f;
+                v >>= 7;
+                buf[len++] = static_cast<char>(v ? byte | 0x80 : byte);
+            } while (v);
+            out.write(buf, len);
+        };
+
+        std::int64_t prev = 0;
+        std::uint64_t written = 0;
+        for (; begin != end; ++begin, ++written) {
+            std::int64_t key;
+            std::uint64_t size = 1;
+            if constexpr (sized) {
+                key = (*begin).key;
+                size = (*begin).size;
+            } else {
+                key = *begin;
+            }
+
+            switch (encoding) {
+            case trace_encoding::fixed32: {
+                std::int32_t v = static_cast<std::int32_t>(key);
+                if (v != key)
+                    throw std::range_error("key does not fit the fixed32 encoding");
+                out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+                break;
+            }
+            case trace_encoding::fixed64:
+                out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+                break;
+            case trace_encoding::varint_delta: {
+                std::int64_t delta = static_cast<std::int64_t>(static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(prev));
+                write_varint((static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63));
+                prev = key;
+                break;
+            }
+            }
+
+            if constexpr (sized) {
+                switch (encoding) {
+                case trace_encoding::fixed32: {
+                    std::uint32_t v = static_cast<std::uint32_t>(size);
+                    if (v != size)
+                        throw std::range_error("size does not fit the fixed32 encoding");
+                    out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+                    break;
+                }
+                case trace_encoding::fixed64:
+                    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+                    break;
+                case trace_encoding::varint_delta:
+                    write_varint(size);
+                    break;
+                }
+            }
+        }
+
+        if (written != count)
+            throw std::runtime_error("trace length does not match its header");
+        if (!out)
+            throw std::runtime_error("failed to write trace");
+    }
+}
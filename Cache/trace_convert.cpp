@@ -0,0 +1,50 @@
+#include "trace.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace caches;
+
+// Converts a trace (text or binary) into the binary format:
+//   trace_convert [--encoding fixed32|fixed64|varint] input output
+int main(int argc, char** argv) try {
+    trace_encoding encoding = trace_encoding::varint_delta;
+    int arg = 1;
+    if (argc > 2 && std::string(argv[1]) == "--encoding") {
+        std::string name = argv[2];
+        if (name == "fixed32")
+            encoding = trace_encoding::fixed32;
+        else if (name == "fixed64")
+            encoding = trace_encoding::fixed64;
+        else if (name != "varint") {
+            std::cerr << "unknown encoding " << name << ", expected one of: fixed32 fixed64 varint\n";
+            return 1;
+        }
+        arg = 3;
+    }
+    if (argc - arg != 2) {
+        std::cerr << "usage: trace_convert [--encoding fixed32|fixed64|varint] input output\n";
+        return 1;
+    }
+
+    auto input = trace::open(argv[arg]);
+    std::ofstream out(argv[arg + 1], std::ios::binary);
+    if (!out) {
+        std::cerr << "cannot open " << argv[arg + 1] << '\n';
+        return 1;
+    }
+    if (input.sized()) {
+        std::vector<sized_key> requests;
+        requests.reserve(input.size());
+        for (auto it = input.begin(); it != input.end(); ++it)
+            requests.push_back({*it, it.object_size()});
+        write_trace(out, input.capacity(), input.size(), requests.begin(), requests.end(), encoding);
+    } else {
+        write_trace(out, input.capacity(), input.size(), input.begin(), input.end(), encoding);
+    }
+} catch (const std::exception& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <utility>
+
+#include "batch.hpp"
+#include "slab.hpp"
+#include "stats.hpp"
+
+namespace caches {
+    // Full 2Q (Johnson & Shasha, VLDB'94). New keys enter the A1in FIFO and are
+    // not reordered by hits there. Keys pushed out of A1in are remembered in
+    // A1out, which holds keys only; a miss on a remembered key goes straight to
+    // Am, the LRU of pages that proved to be re-referenced. A scan therefore only
+    // churns A1in and cannot flush Am.
+    template<typename KeyT = int, typename Hash = std::hash<KeyT>, typename Stats = no_stats>
+    class two_q_cache {
+    public:
+        using size_type = size_t;
+        using hash_type = typename slab_list<KeyT, Hash>::hash_type;
+    public:
+        // in_fraction and out_fraction are Kin and Kout relative to capacity;
+        // 25% and 50% are the values recommended by the paper
+        two_q_cache(size_type capacity, double in_fraction = 0.25, double out_fraction = 0.5, Stats stats = Stats{}) :
+            cap{capacity},
+            kin{static_cast<size_type>(capacity * in_fraction)},
+            kout{static_cast<size_type>(capacity * out_fraction)},
+            a1in{capacity}, a1out{kout}, am{capacity}, stats_{std::move(stats)} {}
+
+        bool full() const { return a1in.size() + am.size() == cap; }
+
+        bool lookup_update(KeyT key) { return lookup_update(key, hash(key)); }
+        bool lookup_update(KeyT key, hash_type h);
+
+        size_type lookup_update_batch(std::span<const KeyT> keys, std::span<bool> hits = {}) {
+            return apply_batch(*this, keys, hits);
+        }
+
+        hash_type hash(const KeyT& key) const { return am.hash(key); }
+        void prefetch(hash_type h) const {
+            am.prefetch(h);
+            a1in.prefetch(h);
+            a1out.prefetch(h);
+        }
+        void prefetch_entry(const KeyT& key, hash_type h) const {
+            am.prefetch_entry(key, h);
+            a1in.prefetch_entry(key, h);
+        }
+
+        bool isPresent(KeyT key) const { return am.contains(key) || a1in.contains(key); }
+
+        bool isGhost(KeyT key) const { return a1out.contains(key); }
+
+        // A1in is reported as the candidate queue, Am as hot and A1out as ghost
+        const Stats& stats() const { return stats_; }
+
+    private:
+        void reclaim();
+
+    private:
+        size_type cap;
+        size_type kin;
+        size_type kout;
+        slab_list<KeyT, Hash> a1in;
+        slab_list<KeyT, Hash> a1out;
+        slab_list<KeyT, Hash> am;
+        [[no_unique_address]] Stats stats_;
+    };
+
+    template <typename KeyT, typename Hash, typename Stats>
+    bool two_q_cache<KeyT, Hash, Stats>::lookup_update(KeyT key, hash_type h) {
+        [[maybe_unused]] auto scope = stats_.lookup();
+        auto hit = am.find(key, h);
+        if (hit != am.npos) {
+            am.move_to_front(hit);
+            stats_.hit(cache_queue::hot);
+            return true;
+        }
+
+        if (a1in.find(key, h) != a1in.npos) {
+            stats_.hit(cache_queue::candidate);
+            return true;
+        }
+
+        if (cap == 0)
+            return false;
+
+        // drop the ghost first: reclaim() may push a1out over its limit
+        auto ghost = a1out.find(key, h);
+        if (ghost != a1out.npos)
+            a1out.erase(ghost);
+
+        bool freeSlot = !full();
+        reclaim();
+        auto q = ghost != a1out.npos ? cache_queue::hot : cache_queue::candidate;
+        if (q == cache_queue::hot) {
+            am.push_front(key, h);
+            stats_.hit(cache_queue::ghost);
+            stats_.promotion();
+        } else {
+            a1in.push_front(key, h);
+        }
+        if (freeSlot)
+            stats_.admission(q);
+        return false;
+    }
+
+    template <typename KeyT, typename Hash, typename Stats>
+    void two_q_cache<KeyT, Hash, Stats>::reclaim() {
+        if (!full())
+            return;
+
+        if (a1in.size() > kin || am.empty()) {
+            KeyT victim = a1in.pop_back();
+            stats_.eviction(cache_queue::candidate);
+            if (kout == 0)
+                return;
+            if (a1out.full()) {
+                a1out.pop_back();
+                stats_.eviction(cache_queue::ghost);
+            }
+            a1out.push_front(victim);
+            return;
+        }
+
+        am.pop_back();
+        stats_.eviction(cache_queue::hot);
+    }
+}